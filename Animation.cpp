@@ -0,0 +1,29 @@
+#include "Animation.hpp"
+
+#include "ChunkFile.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+uint16_t AnimationTable::find(std::string const &name) const {
+	for (uint32_t c = 0; c < clips.size() && c < NoClip; ++c) {
+		if (name == std::string(clips[c].name, strnlen(clips[c].name, sizeof(clips[c].name)))) return uint16_t(c);
+	}
+	return NoClip;
+}
+
+void AnimationTable::load(ChunkFile const &in) {
+	read_chunk(in, "anim", &clips);
+	read_chunk(in, "anfr", &frames);
+	for (AnimationClip const &clip : clips) {
+		std::string name(clip.name, strnlen(clip.name, sizeof(clip.name)));
+		if (clip.frame_count == 0 || size_t(clip.first_frame) + clip.frame_count > frames.size()) {
+			throw std::runtime_error("Animation clip '" + name + "' in '" + in.filename + "' has frames out of range.");
+		}
+		for (uint32_t f = clip.first_frame; f < uint32_t(clip.first_frame) + clip.frame_count; ++f) {
+			if (frames[f].ticks == 0 || frames[f].tile > 255 - 3) {
+				throw std::runtime_error("Animation clip '" + name + "' in '" + in.filename + "' has a malformed frame.");
+			}
+		}
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+/*
+ * Animation -- sprite animation clips, loaded from tilebin and played on entities.
+ *
+ * A clip is a list of frames; each frame shows a 2x2 block of tiles (starting at 'tile')
+ * for some number of simulation ticks. Clips are described in tiles/sprites.txt, e.g.:
+ *   clip cat 4:0.5 0:0.5   (tiles 4-7 for half a second, then tiles 0-3 for half a second, repeat)
+ * and stored in tilebin as an "anim" chunk of AnimationClips plus an "anfr" chunk of AnimationFrames.
+ *
+ * Playback state (clip, frame, ticks left) lives in the entity pools (see EntityStore.hpp);
+ * animate() advances every animated entity in one pass, and only touches an entity's tile
+ * when its frame actually changes.
+ *
+ * Durations are in ticks, not seconds, so animation is as deterministic as the rest of Simulation.
+ *
+ */
+
+#include "EntityStore.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ChunkFile;
+
+struct AnimationClip {
+	char name[12] = {}; //(zero-padded)
+	uint16_t first_frame = 0; //index in the frame list
+	uint16_t frame_count = 0;
+};
+static_assert(sizeof(AnimationClip) == 16, "AnimationClip is packed");
+
+struct AnimationFrame {
+	uint16_t tile = 0; //first of a 2x2 block of tiles
+	uint16_t ticks = 1; //how long the frame shows
+};
+static_assert(sizeof(AnimationFrame) == 4, "AnimationFrame is packed");
+
+struct AnimationTable {
+	std::vector< AnimationClip > clips;
+	std::vector< AnimationFrame > frames;
+
+	enum : uint16_t { NoClip = 0xffff };
+
+	//index of the clip with the given name (or NoClip if there isn't one):
+	uint16_t find(std::string const &name) const;
+
+	//read the "anim" and "anfr" chunks (throws if a clip's frames are out of range or malformed):
+	void load(ChunkFile const &in);
+};
+
+//start entity i playing 'clip' from its first frame (NoClip -- or a clip not in 'table' -- stops it, leaving its tile alone):
+template< uint32_t Capacity >
+void play(AnimationTable const &table, EntityStore< Capacity > *entities, uint32_t i, uint16_t clip) {
+	assert(entities && i < entities->count);
+	entities->clip[i] = clip;
+	entities->frame[i] = 0;
+	if (clip >= table.clips.size()) {
+		entities->frame_ticks[i] = 0;
+		return;
+	}
+	AnimationFrame const &frame = table.frames[table.clips[clip].first_frame];
+	entities->tile[i] = uint8_t(frame.tile);
+	entities->frame_ticks[i] = frame.ticks;
+}
+
+//advance every entity with EntityAnimated by one tick:
+template< uint32_t Capacity >
+void animate(AnimationTable const &table, EntityStore< Capacity > *entities) {
+	assert(entities);
+	uint32_t const count = entities->count;
+	uint32_t const clips = uint32_t(table.clips.size());
+	for (uint32_t i = 0; i < count; ++i) {
+		if (!(entities->flags[i] & EntityAnimated)) continue;
+		if (entities->frame_ticks[i] > 1) {
+			entities->frame_ticks[i] -= 1;
+			continue;
+		}
+		//(clips can disappear when tilebin is reloaded; those entities just stop)
+		uint16_t clip = entities->clip[i];
+		if (clip >= clips) continue;
+		AnimationClip const &c = table.clips[clip];
+		uint16_t frame = uint16_t(entities->frame[i] + 1);
+		if (frame >= c.frame_count) frame = 0;
+		AnimationFrame const &f = table.frames[c.first_frame + frame];
+		entities->frame[i] = frame;
+		entities->tile[i] = uint8_t(f.tile);
+		entities->frame_ticks[i] = f.ticks;
+	}
+}
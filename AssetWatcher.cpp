@@ -0,0 +1,113 @@
+#include "AssetWatcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+AssetWatcher::AssetWatcher(
+	std::vector< std::string > const &source_folders_,
+	std::string const &rebuild_command_,
+	std::string const &tilebin_
+) : source_folders(source_folders_), rebuild_command(rebuild_command_), tilebin(tilebin_) {
+#if defined(__linux__)
+	thread = std::thread(&AssetWatcher::watch, this);
+#endif
+}
+
+AssetWatcher::~AssetWatcher() {
+	quit = true;
+	if (thread.joinable()) thread.join();
+}
+
+std::unique_ptr< TileBin > AssetWatcher::take() {
+	std::lock_guard< std::mutex > lock(loaded_mutex);
+	return std::move(loaded);
+}
+
+void AssetWatcher::watch() {
+#if defined(__linux__)
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0) {
+		std::cerr << "NOTE: couldn't start inotify; asset hot-reload is disabled." << std::endl;
+		return;
+	}
+
+	std::vector< int > source_watches;
+	for (auto const &folder : source_folders) {
+		int wd = inotify_add_watch(fd, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE);
+		if (wd >= 0) source_watches.emplace_back(wd);
+	}
+
+	//process_assets replaces tilebin by renaming a new file over it, so watch the folder that contains it:
+	std::string tilebin_folder = tilebin.substr(0, tilebin.rfind('/'));
+	std::string tilebin_name = tilebin.substr(tilebin.rfind('/') + 1);
+	int tilebin_watch = inotify_add_watch(fd, tilebin_folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+	if (source_watches.empty() && tilebin_watch < 0) {
+		//nothing to watch (e.g., a packaged game without asset sources):
+		close(fd);
+		return;
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	//editors often save in several steps, so wait for changes to settle before rebuilding:
+	constexpr auto SettleTime = std::chrono::milliseconds(250);
+	bool sources_changed = false;
+	Clock::time_point last_change = Clock::now();
+
+	alignas(inotify_event) char buffer[4096];
+	while (!quit) {
+		pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		poll(&pfd, 1, 100); //wake up regularly to check 'quit'
+
+		bool tilebin_changed = false;
+		ssize_t got;
+		while ((got = read(fd, buffer, sizeof(buffer))) > 0) {
+			for (char *at = buffer; at < buffer + got; ) {
+				inotify_event const *event = reinterpret_cast< inotify_event const * >(at);
+				if (event->wd == tilebin_watch && event->len > 0 && tilebin_name == event->name) {
+					tilebin_changed = true;
+				}
+				if (std::find(source_watches.begin(), source_watches.end(), event->wd) != source_watches.end()) {
+					sources_changed = true;
+					last_change = Clock::now();
+				}
+				at += sizeof(inotify_event) + event->len;
+			}
+		}
+
+		if (sources_changed && Clock::now() - last_change >= SettleTime) {
+			sources_changed = false;
+			std::cout << "Assets changed; running " << rebuild_command << std::endl;
+			int result = std::system(rebuild_command.c_str());
+			if (result != 0) {
+				std::cerr << "NOTE: rebuilding assets failed; keeping the current tilebin." << std::endl;
+			}
+			//(if it worked, the new tilebin shows up as an event on the next pass)
+		}
+
+		if (tilebin_changed) {
+			std::unique_ptr< TileBin > bin(new TileBin);
+			try {
+				bin->load(tilebin);
+				std::lock_guard< std::mutex > lock(loaded_mutex);
+				loaded = std::move(bin);
+			} catch (std::exception &e) {
+				std::cerr << "NOTE: failed to reload '" << tilebin << "' (" << e.what() << "); keeping the current one." << std::endl;
+			}
+		}
+	}
+
+	close(fd);
+#endif
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+/*
+ * AssetWatcher -- rebuilds and reloads 'tilebin' while the game is running.
+ *
+ * A background thread watches the asset source folders (e.g., tiles/ and levels/);
+ * when something in them changes it re-runs process_assets, which replaces 'tilebin'.
+ * Whenever 'tilebin' is replaced (by the watcher or by running process_assets by hand),
+ * the thread loads it and hands it to the main thread through take().
+ *
+ * Watching uses inotify, so is only available on Linux; elsewhere the watcher does nothing.
+ *
+ */
+
+#include "TileBin.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct AssetWatcher {
+	AssetWatcher(
+		std::vector< std::string > const &source_folders, //folders whose contents are inputs to process_assets
+		std::string const &rebuild_command, //command that re-runs process_assets
+		std::string const &tilebin //path to the tilebin that process_assets writes
+	);
+	~AssetWatcher();
+
+	//returns the most recently (re-)loaded tilebin, if there is one that hasn't been taken yet:
+	// (call from the main thread, e.g., once per update)
+	std::unique_ptr< TileBin > take();
+
+	//----- internals -----
+	void watch(); //background thread's main loop
+
+	std::vector< std::string > source_folders;
+	std::string rebuild_command;
+	std::string tilebin;
+
+	std::mutex loaded_mutex;
+	std::unique_ptr< TileBin > loaded; //<-- guarded by loaded_mutex
+
+	std::atomic< bool > quit{false};
+	std::thread thread;
+};
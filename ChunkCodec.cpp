@@ -0,0 +1,117 @@
+#include "ChunkCodec.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	//feeds input to inflate() in pieces, as provided by 'next_input':
+	// (output is produced in pieces of at most 'step' bytes, calling 'progress' with the total so far after each)
+	template< typename NextInput >
+	void inflate_into(NextInput const &next_input, void *out, size_t out_size, size_t step = 0, DecompressProgress const &progress = nullptr) {
+		if (step == 0) step = std::max< size_t >(out_size, 1);
+		z_stream stream;
+		std::memset(&stream, 0, sizeof(stream));
+		if (inflateInit(&stream) != Z_OK) {
+			throw std::runtime_error("Failed to initialize inflate.");
+		}
+		Bytef empty = 0; //(somewhere to point for zero-size output)
+		stream.next_out = (out_size ? reinterpret_cast< Bytef * >(out) : &empty);
+		stream.avail_out = 0;
+		size_t given = 0; //output space handed to inflate() so far
+		size_t reported = 0;
+
+		int result = Z_OK;
+		try {
+			while (result == Z_OK) {
+				if (stream.avail_out == 0 && given < out_size) {
+					stream.avail_out = uInt(std::min(step, out_size - given));
+					given += stream.avail_out;
+				}
+				if (stream.avail_in == 0) {
+					if (!next_input(&stream.next_in, &stream.avail_in)) break;
+				}
+				result = inflate(&stream, Z_NO_FLUSH);
+				if (progress && given - stream.avail_out != reported) {
+					reported = given - stream.avail_out;
+					progress(reported);
+				}
+			}
+		} catch (...) {
+			inflateEnd(&stream);
+			throw;
+		}
+		size_t produced = given - stream.avail_out;
+		inflateEnd(&stream);
+
+		if (result != Z_STREAM_END) {
+			throw std::runtime_error("Compressed chunk data is corrupt or truncated.");
+		}
+		if (produced != out_size) {
+			throw std::runtime_error("Compressed chunk data decompressed to " + std::to_string(produced) + " bytes instead of " + std::to_string(out_size) + ".");
+		}
+	}
+}
+
+void compress_chunk(ChunkCodec codec, void const *data, size_t size, std::vector< uint8_t > *out_) {
+	assert(out_);
+	auto &out = *out_;
+
+	uint32_t raw_size = uint32_t(size);
+	out.resize(sizeof(raw_size));
+	std::memcpy(out.data(), &raw_size, sizeof(raw_size));
+
+	if (codec == ChunkCodecDeflate) {
+		uLongf compressed_size = compressBound(uLong(size));
+		out.resize(sizeof(raw_size) + compressed_size);
+		if (compress2(out.data() + sizeof(raw_size), &compressed_size, reinterpret_cast< Bytef const * >(data), uLong(size), Z_BEST_COMPRESSION) != Z_OK) {
+			throw std::runtime_error("Failed to compress chunk.");
+		}
+		out.resize(sizeof(raw_size) + compressed_size);
+	} else {
+		throw std::runtime_error("Unknown chunk codec " + std::to_string(codec) + ".");
+	}
+}
+
+void decompress_chunk(ChunkCodec codec, uint8_t const *data, size_t size, void *out, size_t out_size) {
+	decompress_chunk(codec, data, size, out, out_size, 0, nullptr);
+}
+
+void decompress_chunk(ChunkCodec codec, uint8_t const *data, size_t size, void *out, size_t out_size, size_t step, DecompressProgress const &progress) {
+	if (codec != ChunkCodecDeflate) {
+		throw std::runtime_error("Unknown chunk codec " + std::to_string(codec) + ".");
+	}
+	bool given = false;
+	inflate_into([&](Bytef **next_in, uInt *avail_in) {
+		if (given) return false;
+		given = true;
+		*next_in = const_cast< Bytef * >(data);
+		*avail_in = uInt(size);
+		return true;
+	}, out, out_size, step, progress);
+}
+
+void decompress_chunk(ChunkCodec codec, std::istream &from, size_t size, void *out, size_t out_size) {
+	if (codec != ChunkCodecDeflate) {
+		throw std::runtime_error("Unknown chunk codec " + std::to_string(codec) + ".");
+	}
+	std::vector< Bytef > block(16384);
+	size_t remaining = size;
+	inflate_into([&](Bytef **next_in, uInt *avail_in) {
+		if (remaining == 0) return false;
+		size_t count = std::min(remaining, block.size());
+		if (!from.read(reinterpret_cast< char * >(block.data()), count)) {
+			throw std::runtime_error("Failed to read compressed chunk data.");
+		}
+		remaining -= count;
+		*next_in = block.data();
+		*avail_in = uInt(count);
+		return true;
+	}, out, out_size);
+	//leave the stream just past the chunk, even if the compressed stream ended early:
+	from.ignore(std::streamsize(remaining));
+}
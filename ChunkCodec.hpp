@@ -0,0 +1,48 @@
+#pragma once
+
+/*
+ * Optional per-chunk compression for chunk files (see read_write_chunk.hpp).
+ *
+ * The top four bits of a chunk header's size field say how the chunk's data is stored;
+ * the remaining bits give the stored size in bytes:
+ *
+ * |ma|gi|c.|..| <-- four byte "magic number"
+ * |sz|sz|sz|cs| <-- codec << 28 | stored size
+ *
+ * Compressed chunk data is:
+ * |rs|rs|rs|rs| <-- four byte size of the data once decompressed
+ * |...........| <-- compressed stream
+ *
+ * New codecs can be added by giving them a number here and a case in ChunkCodec.cpp.
+ *
+ */
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+enum ChunkCodec : uint32_t {
+	ChunkCodecRaw = 0,
+	ChunkCodecDeflate = 1, //zlib stream
+};
+
+enum : uint32_t {
+	ChunkCodecShift = 28,
+	ChunkSizeMask = (1U << ChunkCodecShift) - 1,
+};
+
+//compress 'size' bytes of 'data' into 'out' (including the leading decompressed size):
+void compress_chunk(ChunkCodec codec, void const *data, size_t size, std::vector< uint8_t > *out);
+
+//decompress chunk data (after the leading decompressed size) from memory directly into 'out':
+// (throws if the data is corrupt or doesn't decompress to exactly 'out_size' bytes)
+void decompress_chunk(ChunkCodec codec, uint8_t const *data, size_t size, void *out, size_t out_size);
+
+//...or in pieces of (at most) 'step' bytes, calling 'progress' with the number of bytes of 'out' filled so far after each piece:
+// (lets a loader start using the front of a large chunk before the rest is decompressed)
+typedef std::function< void(size_t) > DecompressProgress;
+void decompress_chunk(ChunkCodec codec, uint8_t const *data, size_t size, void *out, size_t out_size, size_t step, DecompressProgress const &progress);
+
+//decompress 'size' bytes of chunk data (after the leading decompressed size) read from a stream in small blocks:
+void decompress_chunk(ChunkCodec codec, std::istream &from, size_t size, void *out, size_t out_size);
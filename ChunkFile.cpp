@@ -0,0 +1,198 @@
+#include "ChunkFile.hpp"
+
+#include "read_write_chunk.hpp"
+#include "crc32c.hpp"
+#include "startup_profile.hpp"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+ChunkFile::ChunkFile(std::string const &filename_, Checks checks_) : checks(checks_), filename(filename_) {
+	#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open '" + filename + "'.");
+	}
+	file_handle = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	mapping_size = size_t(size.QuadPart);
+	if (mapping_size > 0) {
+		HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (map == NULL) {
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map '" + filename + "'.");
+		}
+		mapping_handle = map;
+		mapping = reinterpret_cast< uint8_t const * >(MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0));
+		if (!mapping) {
+			CloseHandle(map);
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map '" + filename + "'.");
+		}
+	}
+	#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open '" + filename + "'.");
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	mapping_size = size_t(info.st_size);
+	if (mapping_size > 0) {
+		void *map = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Failed to map '" + filename + "'.");
+		}
+		mapping = reinterpret_cast< uint8_t const * >(map);
+	}
+	close(fd); //the mapping stays valid after the descriptor is closed
+	#endif
+
+	startup_bytes_read() += mapping_size; //(pages are read on demand, but every byte is eventually checked or copied)
+
+	try {
+		if (!read_toc()) scan();
+	} catch (...) {
+		unmap();
+		throw;
+	}
+	for (uint32_t i = 0; i < chunks.size(); ++i) {
+		index.emplace(chunks[i].magic, i); //(emplace keeps the first chunk with each magic)
+	}
+	verified.reset(new std::atomic< bool >[chunks.size()]);
+	for (uint32_t i = 0; i < chunks.size(); ++i) {
+		verified[i] = false;
+	}
+}
+
+void ChunkFile::verify(Chunk const &chunk) const {
+	if (checks != VerifyChecksums || !chunk.has_checksum) return;
+	assert(&chunk >= chunks.data() && &chunk < chunks.data() + chunks.size());
+	std::atomic< bool > &done = verified[&chunk - chunks.data()];
+	if (done) return;
+	if (crc32c(chunk.data, chunk.size) != chunk.checksum) {
+		throw std::runtime_error("Chunk '" + chunk.magic + "' in '" + filename + "' is corrupt (checksum mismatch).");
+	}
+	done = true;
+}
+
+namespace {
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+}
+
+bool ChunkFile::read_toc() {
+	//files written by ChunkWriter end with a "tail" chunk giving the location (and checksum) of the "toc " chunk:
+	ChunkHeader tail;
+	uint32_t toc_info[2] = {0, 0}; //offset, checksum
+	if (mapping_size < sizeof(tail) + sizeof(toc_info)) return false;
+	std::memcpy(&tail, mapping + mapping_size - sizeof(toc_info) - sizeof(tail), sizeof(tail));
+	if (std::string(tail.magic, 4) != "tail" || tail.size != sizeof(toc_info)) return false;
+	std::memcpy(toc_info, mapping + mapping_size - sizeof(toc_info), sizeof(toc_info));
+	uint32_t toc_offset = toc_info[0];
+	//(this tail -- offset + checksum -- is only written by ChunkWriters that checksum every chunk,
+	// so it also says that every entry has a checksum; files with the older offset-only tail are scanned instead)
+
+	ChunkHeader header;
+	if (toc_offset > mapping_size - sizeof(header)) {
+		throw std::runtime_error("Table of contents of '" + filename + "' is out of bounds.");
+	}
+	std::memcpy(&header, mapping + toc_offset, sizeof(header));
+	if (std::string(header.magic, 4) != "toc " || header.size % sizeof(ChunkTocEntry) != 0
+	 || header.size > mapping_size - toc_offset - sizeof(header)) {
+		throw std::runtime_error("Table of contents of '" + filename + "' is malformed.");
+	}
+
+	if (checks == VerifyChecksums && crc32c(mapping + toc_offset + sizeof(header), header.size) != toc_info[1]) {
+		throw std::runtime_error("Table of contents of '" + filename + "' is corrupt (checksum mismatch).");
+	}
+
+	uint32_t count = header.size / sizeof(ChunkTocEntry);
+	chunks.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		ChunkTocEntry entry;
+		std::memcpy(&entry, mapping + toc_offset + sizeof(header) + i * sizeof(entry), sizeof(entry));
+		uint32_t size = entry.size & ChunkSizeMask;
+		if (entry.offset > mapping_size || size > mapping_size - entry.offset) {
+			throw std::runtime_error("Chunk '" + std::string(entry.magic, 4) + "' runs past the end of '" + filename + "'.");
+		}
+		Chunk chunk;
+		chunk.magic = std::string(entry.magic, 4);
+		chunk.data = mapping + entry.offset;
+		chunk.size = size;
+		chunk.codec = ChunkCodec(entry.size >> ChunkCodecShift);
+		chunk.has_checksum = true; //(ChunkWriter checksums every chunk it lists)
+		chunk.checksum = entry.checksum;
+		chunks.emplace_back(chunk);
+	}
+	return true;
+}
+
+void ChunkFile::scan() {
+	//no table of contents, so walk the chunk headers:
+	size_t at = 0;
+	while (at < mapping_size) {
+		ChunkHeader header;
+		if (mapping_size - at < sizeof(header)) {
+			throw std::runtime_error("Failed to read chunk header in '" + filename + "'.");
+		}
+		std::memcpy(&header, mapping + at, sizeof(header));
+		at += sizeof(header);
+		uint32_t size = header.size & ChunkSizeMask;
+		if (mapping_size - at < size) {
+			throw std::runtime_error("Chunk '" + std::string(header.magic, 4) + "' runs past the end of '" + filename + "'.");
+		}
+		if (std::string(header.magic, 4) != "pad ") { //(padding isn't a real chunk)
+			Chunk chunk;
+			chunk.magic = std::string(header.magic, 4);
+			chunk.data = mapping + at;
+			chunk.size = size;
+			chunk.codec = ChunkCodec(header.size >> ChunkCodecShift);
+			chunks.emplace_back(chunk);
+		}
+		at += size;
+	}
+}
+
+ChunkFile::~ChunkFile() {
+	unmap();
+}
+
+void ChunkFile::unmap() {
+	#if defined(_WIN32)
+	if (mapping) UnmapViewOfFile(mapping);
+	if (mapping_handle) CloseHandle(mapping_handle);
+	if (file_handle) CloseHandle(file_handle);
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+	#else
+	if (mapping) munmap(const_cast< uint8_t * >(mapping), mapping_size);
+	#endif
+	mapping = nullptr;
+	mapping_size = 0;
+}
+
+ChunkFile::Chunk const *ChunkFile::find(std::string const &magic) const {
+	auto f = index.find(magic);
+	if (f == index.end()) return nullptr;
+	return &chunks[f->second];
+}
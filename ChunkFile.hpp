@@ -0,0 +1,163 @@
+#pragma once
+
+/*
+ * ChunkFile -- read-only, memory-mapped access to a file of chunks (as written by write_chunk).
+ *
+ * Opening a ChunkFile maps the file and notes where each chunk starts
+ * (using the table of contents written by ChunkWriter, or by walking the chunk headers in older files);
+ * chunks can then be looked up by magic number in any order, chunks nobody asks for are never touched,
+ * and chunk contents are used directly from the mapping (no zero-fill, no copy),
+ * so only the pages that are actually used get read from disk.
+ *
+ * //e.g.:
+ * ChunkFile file(data_path("../tilebin"));
+ * ChunkFile::Span< PPU466::Tile > tiles = file.get< PPU466::Tile >("tile");
+ * for (PPU466::Tile const &tile : tiles) { ... }
+ *
+ * Spans point into the mapping, so they are only valid while the ChunkFile exists.
+ * (ChunkWriter aligns every chunk's data, so get() works for files it wrote;
+ *  the copying read_chunk() doesn't need alignment at all.)
+ *
+ * If the file has checksums (see ChunkWriter), each chunk is checked the first time it is used,
+ * and a corrupt or truncated file throws instead of handing out garbage.
+ * Builds that trust their data can skip this by passing SkipChecksums,
+ * or by defining CHUNK_FILE_TRUSTED to make that the default.
+ *
+ */
+
+#include "ChunkCodec.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <stdexcept>
+#include <cassert>
+
+struct ChunkFile {
+	enum Checks {
+		VerifyChecksums,
+		SkipChecksums,
+		#ifdef CHUNK_FILE_TRUSTED
+		DefaultChecks = SkipChecksums
+		#else
+		DefaultChecks = VerifyChecksums
+		#endif
+	};
+
+	//map a file (throws on error):
+	explicit ChunkFile(std::string const &filename, Checks checks = DefaultChecks);
+	~ChunkFile();
+
+	ChunkFile(ChunkFile const &) = delete;
+	ChunkFile &operator=(ChunkFile const &) = delete;
+
+	//A Span is a typed view of (part of) the mapping:
+	template< typename T >
+	struct Span {
+		T const *data = nullptr;
+		size_t size = 0;
+
+		T const *begin() const { return data; }
+		T const *end() const { return data + size; }
+		T const &operator[](size_t i) const { assert(i < size); return data[i]; }
+		bool empty() const { return size == 0; }
+	};
+
+	//raw location of each chunk in the file (found when opening):
+	struct Chunk {
+		std::string magic;
+		uint8_t const *data = nullptr;
+		uint32_t size = 0; //stored size
+		ChunkCodec codec = ChunkCodecRaw; //how the data is stored (see ChunkCodec.hpp)
+		bool has_checksum = false; //was a checksum recorded? (files with a checksummed table of contents record one for every chunk)
+		uint32_t checksum = 0; //from the table of contents (any value is valid when has_checksum is set)
+	};
+	std::vector< Chunk > chunks;
+
+	//first chunk with the given magic number (or nullptr if there isn't one):
+	// (call verify() before using the chunk's data)
+	Chunk const *find(std::string const &magic) const;
+
+	//throw if the chunk's data doesn't match its checksum:
+	// (each chunk is only actually checked once; safe to call from several threads)
+	void verify(Chunk const &chunk) const;
+	Checks checks;
+
+	//the contents of the first chunk with the given magic, viewed as an array of T:
+	// throws if the chunk is missing, compressed (use read_chunk instead), isn't a whole number of Ts, or isn't aligned for T.
+	template< typename T >
+	Span< T > get(std::string const &magic) const;
+
+	//----- internals -----
+	bool read_toc(); //fill 'chunks' from the table of contents, if there is one
+	void scan(); //fill 'chunks' by walking chunk headers
+	void unmap();
+	std::unordered_map< std::string, uint32_t > index; //magic -> first chunk with that magic
+	std::unique_ptr< std::atomic< bool >[] > verified; //has chunks[i] been checked yet?
+	std::string filename;
+	uint8_t const *mapping = nullptr;
+	size_t mapping_size = 0;
+	#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+	#endif
+};
+
+template< typename T >
+ChunkFile::Span< T > ChunkFile::get(std::string const &magic) const {
+	Chunk const *chunk = find(magic);
+	if (!chunk) {
+		throw std::runtime_error("No '" + magic + "' chunk in '" + filename + "'.");
+	}
+	if (chunk->codec != ChunkCodecRaw) {
+		throw std::runtime_error("The '" + magic + "' chunk is compressed, so can't be used in place.");
+	}
+	verify(*chunk);
+	if (chunk->size % sizeof(T) != 0) {
+		throw std::runtime_error("Size of '" + magic + "' chunk not divisible by element size.");
+	}
+	if (reinterpret_cast< uintptr_t >(chunk->data) % alignof(T) != 0) {
+		throw std::runtime_error("Data of '" + magic + "' chunk is not aligned for its element type.");
+	}
+	Span< T > span;
+	span.data = reinterpret_cast< T const * >(chunk->data);
+	span.size = chunk->size / sizeof(T);
+	return span;
+}
+
+//copying version with the same interface as read_chunk(std::istream &, ...):
+// (fills 'to' straight from the mapping, so elements aren't zeroed first;
+//  compressed chunks are decompressed straight from the mapping into 'to')
+template< typename T >
+void read_chunk(ChunkFile const &from, std::string const &magic, std::vector< T > *to_) {
+	assert(to_);
+	ChunkFile::Chunk const *chunk = from.find(magic);
+	if (chunk && chunk->codec != ChunkCodecRaw) {
+		from.verify(*chunk);
+		uint32_t raw_size = 0;
+		if (chunk->size < sizeof(raw_size)) {
+			throw std::runtime_error("Compressed '" + magic + "' chunk is too small.");
+		}
+		std::memcpy(&raw_size, chunk->data, sizeof(raw_size));
+		if (raw_size % sizeof(T) != 0) {
+			throw std::runtime_error("Size of '" + magic + "' chunk not divisible by element size.");
+		}
+		to_->resize(raw_size / sizeof(T));
+		decompress_chunk(chunk->codec, chunk->data + sizeof(raw_size), chunk->size - sizeof(raw_size), to_->data(), raw_size);
+		return;
+	}
+	//raw chunks are copied with memcpy, so they needn't be aligned for T:
+	if (!chunk) {
+		throw std::runtime_error("No '" + magic + "' chunk in '" + from.filename + "'.");
+	}
+	from.verify(*chunk);
+	if (chunk->size % sizeof(T) != 0) {
+		throw std::runtime_error("Size of '" + magic + "' chunk not divisible by element size.");
+	}
+	to_->resize(chunk->size / sizeof(T));
+	if (chunk->size) std::memcpy(to_->data(), chunk->data, chunk->size);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+/*
+ * EntityStore -- the game's moving objects, stored as a structure of arrays.
+ *
+ * Each component lives in its own fixed-size array (a "pool"), packed so that entities [0, count)
+ * are the live ones; systems (see Simulation::step and PlayMode::draw) just walk each pool from 0 to count.
+ * Destroying an entity moves the last entity into its place, so pools never have holes.
+ *
+ * Since entities move around in the pools, they are referred to by EntityHandle,
+ * which stays valid until the entity is destroyed (and is detectably stale afterwards):
+ *
+ * //e.g.:
+ * EntityStore< 256 > store;
+ * EntityHandle box = store.create();
+ * store.position[store.index(box)] = glm::vec2(16.0f, 32.0f);
+ * store.destroy(box); //store.alive(box) is now false
+ *
+ * The store has no pointers and a fixed size, so copying it (e.g., into Simulation::State) is a flat copy.
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+//a slot (stable for the entity's lifetime) and the slot's generation when it was handed out:
+struct EntityHandle {
+	uint16_t slot = 0xffff;
+	uint16_t generation = 0;
+};
+
+//what an entity is (decides, e.g., how it is drawn):
+enum EntityKind : uint8_t {
+	EntityPlayer,
+	EntityBox,
+};
+
+//which systems apply to an entity:
+enum EntityFlags : uint8_t {
+	EntityFalls = 1 << 0, //pulled down by gravity
+	EntityAnimated = 1 << 1, //plays its animation clip (see Animation.hpp)
+};
+
+template< uint32_t Capacity >
+struct EntityStore {
+	static_assert(Capacity <= 0xffff, "slots fit in 16 bits");
+
+	template< typename T >
+	using Pool = std::array< T, Capacity >;
+
+	//----- components (entity i, for i < count, is element i of every pool) -----
+	Pool< glm::vec2 > position; //pixels, lower left
+	Pool< glm::vec2 > velocity; //pixels / second
+	Pool< uint8_t > kind; //EntityKind
+	Pool< uint8_t > flags; //EntityFlags
+	Pool< uint8_t > tile; //first of the entity's 2x2 block of tiles (set by the animation, if it has one)
+	Pool< uint16_t > clip; //animation clip (index in an AnimationTable)
+	Pool< uint16_t > frame; //current frame of 'clip'
+	Pool< uint16_t > frame_ticks; //ticks left in the current frame
+	uint32_t count = 0;
+
+	EntityStore() {
+		//(unused entries are zeroed too, so copies of the store are deterministic byte for byte)
+		position.fill(glm::vec2(0.0f));
+		velocity.fill(glm::vec2(0.0f));
+		kind.fill(0);
+		flags.fill(0);
+		tile.fill(0);
+		clip.fill(0);
+		frame.fill(0);
+		frame_ticks.fill(0);
+		for (uint32_t i = 0; i < Capacity; ++i) {
+			dense_to_slot[i] = uint16_t(i);
+			slot_to_dense[i] = uint16_t(i);
+			generation[i] = 0;
+		}
+	}
+
+	//add an entity (components are zeroed; throws if the store is full):
+	EntityHandle create() {
+		if (count == Capacity) throw std::runtime_error("EntityStore is full (" + std::to_string(Capacity) + " entities).");
+		uint32_t i = count++;
+		position[i] = glm::vec2(0.0f);
+		velocity[i] = glm::vec2(0.0f);
+		kind[i] = 0;
+		flags[i] = 0;
+		tile[i] = 0;
+		clip[i] = 0;
+		frame[i] = 0;
+		frame_ticks[i] = 0;
+		EntityHandle handle;
+		handle.slot = dense_to_slot[i];
+		handle.generation = generation[handle.slot];
+		return handle;
+	}
+
+	//remove an entity (the last entity takes its place in the pools):
+	void destroy(EntityHandle handle) {
+		assert(alive(handle));
+		uint32_t i = slot_to_dense[handle.slot];
+		uint32_t last = --count;
+		if (i != last) {
+			position[i] = position[last];
+			velocity[i] = velocity[last];
+			kind[i] = kind[last];
+			flags[i] = flags[last];
+			tile[i] = tile[last];
+			clip[i] = clip[last];
+			frame[i] = frame[last];
+			frame_ticks[i] = frame_ticks[last];
+			uint16_t moved = dense_to_slot[last];
+			dense_to_slot[i] = moved;
+			slot_to_dense[moved] = uint16_t(i);
+		}
+		//(the freed slot goes just past the live ones, ready for the next create)
+		dense_to_slot[last] = handle.slot;
+		slot_to_dense[handle.slot] = uint16_t(last);
+		generation[handle.slot] += 1;
+	}
+
+	//remove every entity (all handles go stale):
+	void clear() {
+		for (uint32_t i = 0; i < count; ++i) {
+			generation[dense_to_slot[i]] += 1;
+		}
+		count = 0;
+	}
+
+	bool alive(EntityHandle handle) const {
+		return handle.slot < Capacity && generation[handle.slot] == handle.generation && slot_to_dense[handle.slot] < count;
+	}
+
+	//where the entity currently is in the pools:
+	uint32_t index(EntityHandle handle) const {
+		assert(alive(handle));
+		return slot_to_dense[handle.slot];
+	}
+
+	//----- internals -----
+	//dense_to_slot is a permutation of all slots: the first 'count' belong to live entities, the rest are free
+	Pool< uint16_t > dense_to_slot;
+	Pool< uint16_t > slot_to_dense;
+	Pool< uint16_t > generation;
+};
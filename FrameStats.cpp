@@ -0,0 +1,178 @@
+#include "FrameStats.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+uint32_t FrameHistogram::bucket(uint64_t us) {
+	//values below SubBuckets get a bucket each; above that, each doubling is split into SubBuckets pieces:
+	if (us < SubBuckets) return uint32_t(us);
+	uint32_t e = 0;
+	while ((us >> e) >= 2 * SubBuckets) ++e;
+	//now SubBuckets <= (us >> e) < 2 * SubBuckets:
+	uint32_t b = (e + 1) * SubBuckets + uint32_t((us >> e) - SubBuckets);
+	return std::min(b, uint32_t(Buckets) - 1);
+}
+
+uint64_t FrameHistogram::bucket_low(uint32_t b) {
+	if (b < SubBuckets) return b;
+	uint32_t e = b / SubBuckets - 1;
+	return (uint64_t(SubBuckets) + b % SubBuckets) << e;
+}
+
+void FrameHistogram::add(double seconds) {
+	uint64_t us = uint64_t(std::max(0.0, seconds) * 1e6 + 0.5);
+	counts[bucket(us)].fetch_add(1, std::memory_order_relaxed);
+	total_count.fetch_add(1, std::memory_order_relaxed);
+	total_us.fetch_add(us, std::memory_order_relaxed);
+	uint64_t old_max = max_us.load(std::memory_order_relaxed);
+	while (us > old_max && !max_us.compare_exchange_weak(old_max, us, std::memory_order_relaxed)) { }
+}
+
+void FrameHistogram::clear() {
+	for (auto &count : counts) {
+		count.store(0, std::memory_order_relaxed);
+	}
+	total_count.store(0, std::memory_order_relaxed);
+	total_us.store(0, std::memory_order_relaxed);
+	max_us.store(0, std::memory_order_relaxed);
+}
+
+double FrameHistogram::mean_ms() const {
+	uint64_t n = count();
+	return n ? total_us.load(std::memory_order_relaxed) / 1000.0 / double(n) : 0.0;
+}
+
+double FrameHistogram::max_ms() const {
+	return max_us.load(std::memory_order_relaxed) / 1000.0;
+}
+
+double FrameHistogram::percentile_ms(double p) const {
+	//(counts may change while this runs; the answer is still some recent percentile)
+	uint64_t n = count();
+	if (n == 0) return 0.0;
+	uint64_t rank = std::max< uint64_t >(1, uint64_t(std::ceil(p * double(n))));
+	uint64_t seen = 0;
+	for (uint32_t b = 0; b < Buckets; ++b) {
+		seen += counts[b].load(std::memory_order_relaxed);
+		if (seen >= rank) {
+			double mid = 0.5 * double(bucket_low(b) + (b + 1 < Buckets ? bucket_low(b + 1) : bucket_low(b)));
+			return std::min(mid, double(max_us.load(std::memory_order_relaxed))) / 1000.0;
+		}
+	}
+	return max_ms();
+}
+
+void FrameStats::write_csv(std::string const &folder) const {
+	struct Series {
+		char const *name;
+		FrameHistogram const &histogram;
+	};
+	Series series[4] = { {"frame", frame}, {"update", update}, {"draw", draw}, {"swap", swap} };
+
+	{
+		std::ofstream out(folder + "frame-stats.csv");
+		out << "series,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+		for (auto const &s : series) {
+			FrameHistogram const &h = s.histogram;
+			out << s.name << "," << h.count() << "," << h.mean_ms() << "," << h.percentile_ms(0.50) << ","
+				<< h.percentile_ms(0.95) << "," << h.percentile_ms(0.99) << "," << h.max_ms() << "\n";
+		}
+	}
+	{
+		std::ofstream out(folder + "frame-histogram.csv");
+		out << "low_ms,high_ms,frame,update,draw,swap\n";
+		for (uint32_t b = 0; b < FrameHistogram::Buckets; ++b) {
+			uint32_t counts[4];
+			bool any = false;
+			for (uint32_t i = 0; i < 4; ++i) {
+				counts[i] = series[i].histogram.counts[b].load(std::memory_order_relaxed);
+				any = any || counts[i] != 0;
+			}
+			if (!any) continue;
+			uint64_t high = (b + 1 < FrameHistogram::Buckets ? FrameHistogram::bucket_low(b + 1) : FrameHistogram::bucket_low(b));
+			out << FrameHistogram::bucket_low(b) / 1000.0 << "," << high / 1000.0 << "," << counts[0] << "," << counts[1] << "," << counts[2] << "," << counts[3] << "\n";
+		}
+	}
+	std::cout << "Frame times (ms): p50 " << frame.percentile_ms(0.50) << ", p95 " << frame.percentile_ms(0.95)
+		<< ", p99 " << frame.percentile_ms(0.99) << ", max " << frame.max_ms() << " over " << frame.count() << " frames." << std::endl;
+}
+
+namespace {
+	//3x5 glyphs for "0123456789.", one row per byte (top row first), bit 2 is the leftmost pixel:
+	constexpr uint8_t Glyphs[FrameStats::GlyphCount][5] = {
+		{7,5,5,5,7}, {2,6,2,2,7}, {7,1,7,4,7}, {7,1,7,1,7}, {5,5,7,1,1},
+		{7,4,7,1,7}, {7,4,7,5,7}, {7,1,1,1,1}, {7,5,7,5,7}, {7,5,7,1,7},
+		{0,0,0,0,2},
+	};
+}
+
+void FrameStats::draw_overlay(PPU466 *ppu_, uint32_t first_tile, uint32_t palette, uint32_t first_sprite) const {
+	assert(ppu_);
+	PPU466 &ppu = *ppu_;
+	assert(first_tile + GlyphCount <= ppu.tile_table.size());
+	assert(palette < ppu.palette_table.size());
+	assert(first_sprite + MaxSprites <= ppu.sprites.size());
+
+	//glyphs are color 1 on a 5x7 box of color 2 (so they are readable over anything):
+	// (glyph pixels are x in [1,4), y in [1,6) of the tile; the box is x in [0,5), y in [0,7); bit x of a row is pixel x)
+	for (uint32_t g = 0; g < GlyphCount; ++g) {
+		PPU466::Tile &tile = ppu.tile_table[first_tile + g];
+		for (uint32_t y = 0; y < 8; ++y) {
+			uint8_t glyph = 0;
+			if (y >= 1 && y < 6) {
+				uint8_t row = Glyphs[g][5 - y];
+				glyph = uint8_t(((row >> 2) & 1) << 1 | ((row >> 1) & 1) << 2 | (row & 1) << 3);
+			}
+			uint8_t box = (y < 7 ? 0x1f : 0x00);
+			tile.bit0[y] = glyph;
+			tile.bit1[y] = uint8_t(box & ~glyph);
+		}
+	}
+	ppu.palette_table[palette] = PPU466::Palette{
+		glm::u8vec4(0x00, 0x00, 0x00, 0x00),
+		glm::u8vec4(0xff, 0xff, 0xff, 0xff),
+		glm::u8vec4(0x00, 0x00, 0x00, 0xc0),
+		glm::u8vec4(0x00, 0x00, 0x00, 0x00),
+	};
+
+	char text[32];
+	snprintf(text, sizeof(text), "%.1f %.1f %.1f", frame.percentile_ms(0.50), frame.percentile_ms(0.99), frame.max_ms());
+
+	uint32_t s = 0;
+	int32_t x = 2;
+	for (char const *c = text; *c && s < MaxSprites; ++c) {
+		if (*c == ' ') {
+			x += 5;
+			continue;
+		}
+		uint32_t glyph = (*c == '.' ? 10 : uint32_t(*c - '0'));
+		if (glyph >= GlyphCount) continue;
+		PPU466::Sprite &sprite = ppu.sprites[first_sprite + s];
+		sprite.x = uint8_t(std::min(x, 255));
+		sprite.y = uint8_t(PPU466::ScreenHeight - 9);
+		sprite.index = uint8_t(first_tile + glyph);
+		sprite.attributes = uint8_t(palette); //(in front of the background)
+		x += 5;
+		s += 1;
+	}
+	//hide any unused overlay sprites:
+	for (; s < MaxSprites; ++s) {
+		ppu.sprites[first_sprite + s].y = 250;
+	}
+}
+
+void FrameStats::clear() {
+	frame.clear();
+	update.clear();
+	draw.clear();
+	swap.clear();
+}
+
+FrameStats &frame_stats() {
+	static FrameStats stats;
+	return stats;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/*
+ * FrameStats -- histograms of frame, update, draw, and swap times, for spotting stutter.
+ *
+ * Times go into log-spaced buckets (64 per doubling, so percentiles are within ~1.5%),
+ * counted with relaxed atomics: adding is lock-free and any thread can read percentiles at any time.
+ *
+ * main() feeds frame_stats() every frame and writes it out on exit:
+ *  frame-stats.csv -- count, mean, p50, p95, p99, and max of each series (in ms)
+ *  frame-histogram.csv -- bucket bounds and per-series counts for every non-empty bucket
+ *
+ * draw_overlay() shows the frame-time percentiles on screen using spare PPU466 tiles, a spare palette, and spare sprites.
+ *
+ */
+
+#include "PPU466.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+struct FrameHistogram {
+	//bucket 'b' holds times in [bucket_low(b), bucket_low(b+1)) microseconds:
+	enum : uint32_t {
+		SubBuckets = 64, //buckets per doubling
+		Buckets = SubBuckets * 28, //up to ~2 hours, which is plenty for a frame
+	};
+	static uint32_t bucket(uint64_t us);
+	static uint64_t bucket_low(uint32_t b);
+
+	void add(double seconds);
+	void clear(); //(not atomic as a whole; don't add() at the same time)
+
+	uint64_t count() const { return total_count.load(std::memory_order_relaxed); }
+	double mean_ms() const;
+	double max_ms() const;
+	//time (ms) that fraction 'p' of samples are at or below (reported as the middle of the bucket it falls in):
+	double percentile_ms(double p) const;
+
+	std::atomic< uint32_t > counts[Buckets] = { };
+	std::atomic< uint64_t > total_count{0};
+	std::atomic< uint64_t > total_us{0};
+	std::atomic< uint64_t > max_us{0};
+};
+
+struct FrameStats {
+	FrameHistogram frame; //time between frames
+	FrameHistogram update; //time in Mode::update
+	FrameHistogram draw; //time in Mode::draw
+	FrameHistogram swap; //time in SDL_GL_SwapWindow
+
+	void clear();
+
+	//write frame-stats.csv and frame-histogram.csv to 'folder' (which should end with a path separator):
+	void write_csv(std::string const &folder) const;
+
+	//what draw_overlay() takes over:
+	enum : uint32_t {
+		GlyphCount = 11, //tiles ("0123456789.")
+		MaxSprites = 16, //sprites (at most)
+	};
+
+	//show "p50 p99 max" frame times (ms) along the top of the screen:
+	// - tiles [first_tile, first_tile + GlyphCount) get overwritten with digit glyphs
+	// - palette 'palette' gets overwritten with overlay colors
+	// - sprites [first_sprite, first_sprite + MaxSprites) get used for text
+	void draw_overlay(PPU466 *ppu, uint32_t first_tile, uint32_t palette, uint32_t first_sprite) const;
+};
+
+//the stats for this run:
+FrameStats &frame_stats();
@@ -0,0 +1,97 @@
+#include "InputReplay.hpp"
+
+#include "ChunkFile.hpp"
+#include "read_write_chunk.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+	void put_varint(uint32_t value, std::vector< uint8_t > *to) {
+		while (value >= 0x80) {
+			to->emplace_back(uint8_t(value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		to->emplace_back(uint8_t(value));
+	}
+
+	uint32_t get_varint(uint8_t const *&at, uint8_t const *end) {
+		uint32_t value = 0;
+		for (uint32_t shift = 0; shift < 35; shift += 7) {
+			if (at == end) throw std::runtime_error("Replay events end in the middle of a number.");
+			uint8_t byte = *(at++);
+			value |= uint32_t(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) return value;
+		}
+		throw std::runtime_error("Replay events contain an over-long number.");
+	}
+}
+
+InputReplay::InputReplay(std::string const &filename) {
+	ChunkFile file(filename);
+	ChunkFile::Span< ReplayHeader > headers = file.get< ReplayHeader >("rplh");
+	if (headers.size != 1 || headers[0].version != 1) {
+		throw std::runtime_error("'" + filename + "' isn't a replay this version can play.");
+	}
+	header = headers[0];
+
+	ChunkFile::Span< uint8_t > bytes = file.get< uint8_t >("rple");
+	uint8_t const *at = bytes.begin();
+	uint32_t tick = 0;
+	while (at != bytes.end()) {
+		Event event;
+		tick += get_varint(at, bytes.end());
+		uint32_t packed = get_varint(at, bytes.end());
+		event.tick = tick;
+		event.key = SDL_Keycode(packed >> 2) | ((packed & 2) ? SDLK_SCANCODE_MASK : 0);
+		event.down = (packed & 1) != 0;
+		events.emplace_back(event);
+	}
+}
+
+bool InputReplay::record(uint32_t tick, SDL_Event const &evt) {
+	if (evt.type != SDL_KEYDOWN && evt.type != SDL_KEYUP) return false;
+	Event event;
+	event.tick = tick;
+	event.key = evt.key.keysym.sym;
+	event.down = (evt.type == SDL_KEYDOWN);
+	events.emplace_back(event);
+	return true;
+}
+
+std::vector< SDL_Event > const &InputReplay::events_at(uint32_t tick) {
+	at_tick.clear();
+	while (next < events.size() && events[next].tick <= tick) {
+		Event const &event = events[next++];
+		SDL_Event evt;
+		std::memset(&evt, 0, sizeof(evt));
+		evt.type = (event.down ? SDL_KEYDOWN : SDL_KEYUP);
+		evt.key.type = evt.type;
+		evt.key.state = (event.down ? SDL_PRESSED : SDL_RELEASED);
+		evt.key.keysym.sym = event.key;
+		at_tick.emplace_back(evt);
+	}
+	return at_tick;
+}
+
+void InputReplay::save(std::string const &filename) const {
+	std::vector< uint8_t > bytes;
+	bytes.reserve(events.size() * 3);
+	uint32_t tick = 0;
+	for (Event const &event : events) {
+		put_varint(event.tick - tick, &bytes);
+		tick = event.tick;
+		uint32_t key = uint32_t(event.key) & ~uint32_t(SDLK_SCANCODE_MASK);
+		put_varint((key << 2) | ((event.key & SDLK_SCANCODE_MASK) ? 2 : 0) | (event.down ? 1 : 0), &bytes);
+	}
+
+	std::ofstream out(filename, std::ios::binary);
+	ChunkWriter writer(&out);
+	writer.write("rplh", std::vector< ReplayHeader >{ header });
+	writer.write("rple", bytes);
+	writer.finish();
+	if (!out) {
+		throw std::runtime_error("Failed to write replay to '" + filename + "'.");
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+/*
+ * InputReplay -- the input a PlayMode consumed, by tick, so a run can be played back exactly.
+ *
+ * PlayMode steps its simulation at a fixed rate (Simulation::Tick); each key event it handles is
+ * recorded with the number of the tick it arrived before. Feeding the same events in before the
+ * same ticks (on the same level data) reproduces the run, down to the last bit of float state.
+ *
+ * //e.g.:
+ * InputReplay recording;
+ * recording.record(tick, evt); //...for every event handled
+ * recording.ticks = tick; recording.save("run.replay");
+ *
+ * InputReplay replay("run.replay");
+ * for (SDL_Event const &evt : replay.events_at(tick)) { ... }
+ *
+ * Replay files use the chunk format (see read_write_chunk.hpp):
+ *  "rplh" -- one ReplayHeader
+ *  "rple" -- the events, as a byte stream of pairs of varints:
+ *            (tick - previous event's tick), (key << 2 | scancode-keycode bit << 1 | down)
+ *            (where 'key' is the keycode without SDLK_SCANCODE_MASK, so arrows etc. take two bytes)
+ * ...so a typical event takes three bytes.
+ *
+ */
+
+#include <SDL.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct InputReplay {
+	InputReplay() = default;
+	explicit InputReplay(std::string const &filename); //load (throws on error)
+
+	//a recorded key press or release:
+	struct Event {
+		uint32_t tick = 0;
+		SDL_Keycode key = 0;
+		bool down = false;
+	};
+	std::vector< Event > events; //in tick order
+
+	//what the run started from and where it ended up:
+	struct ReplayHeader {
+		uint32_t version = 1;
+		int32_t level_index = 0; //level that was being played
+		uint32_t ticks = 0; //total ticks in the run
+		uint32_t final_state = 0; //Simulation::state_checksum() after the last tick (every recording sets it, so 0 is a checksum too)
+	};
+	static_assert(sizeof(ReplayHeader) == 16, "header is packed");
+	ReplayHeader header;
+
+	//add an event (only key presses and releases are kept; returns false for anything else):
+	bool record(uint32_t tick, SDL_Event const &evt);
+
+	//the events recorded for 'tick', rebuilt as SDL key events:
+	// (advances an internal cursor, so call with non-decreasing ticks)
+	std::vector< SDL_Event > const &events_at(uint32_t tick);
+
+	//write to a file (throws on error):
+	void save(std::string const &filename) const;
+
+	//----- internals -----
+	size_t next = 0; //first event not yet handed out by events_at
+	std::vector< SDL_Event > at_tick; //storage for events_at's result
+};
@@ -0,0 +1,62 @@
+#include "Level.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+void pack_levels(std::vector< Level > const &levels, ChunkCodec codec, std::vector< LevelHeader > *headers_, std::vector< uint8_t > *records_) {
+	assert(headers_);
+	assert(records_);
+	auto &headers = *headers_;
+	auto &records = *records_;
+	headers.clear();
+	records.clear();
+	std::vector< uint8_t > compressed;
+	for (Level const &level : levels) {
+		assert(level.cells.size() == level.width * level.height);
+		if (level.width > 0xffff || level.height > 0xffff) {
+			throw std::runtime_error("Level is " + std::to_string(level.width) + "x" + std::to_string(level.height) + " cells; at most 65535 on a side can be stored.");
+		}
+		LevelHeader header;
+		header.offset = uint32_t(records.size());
+		header.width = uint16_t(level.width);
+		header.height = uint16_t(level.height);
+		header.start_x = int16_t(level.starting_pos.x);
+		header.start_y = int16_t(level.starting_pos.y);
+		compressed.clear();
+		if (codec != ChunkCodecRaw) compress_chunk(codec, level.cells.data(), level.cells.size(), &compressed);
+		if (codec != ChunkCodecRaw && compressed.size() < level.cells.size()) {
+			header.codec = codec;
+			records.insert(records.end(), compressed.begin(), compressed.end());
+		} else {
+			records.insert(records.end(), level.cells.begin(), level.cells.end());
+		}
+		header.size = uint32_t(records.size() - header.offset);
+		headers.emplace_back(header);
+	}
+}
+
+Level unpack_level(LevelHeader const &header, uint8_t const *records, size_t records_size) {
+	if (header.offset > records_size || header.size > records_size - header.offset) {
+		throw std::runtime_error("Level record runs past the end of the level data.");
+	}
+	uint8_t const *record = records + header.offset;
+	Level level;
+	level.width = header.width;
+	level.height = header.height;
+	level.starting_pos = glm::vec2(header.start_x, header.start_y);
+	size_t count = size_t(header.width) * size_t(header.height);
+	if (header.codec == ChunkCodecRaw) {
+		if (header.size != count) throw std::runtime_error("Level record is the wrong size for its cells.");
+		level.cells.assign(record, record + count);
+	} else {
+		uint32_t raw_size = 0;
+		if (header.size < sizeof(raw_size)) throw std::runtime_error("Compressed level record is too small.");
+		std::memcpy(&raw_size, record, sizeof(raw_size));
+		if (raw_size != count) throw std::runtime_error("Level record is the wrong size for its cells.");
+		level.cells.resize(count);
+		decompress_chunk(ChunkCodec(header.codec), record + sizeof(raw_size), header.size - sizeof(raw_size), level.cells.data(), count);
+	}
+	return level;
+}
@@ -1,14 +1,65 @@
 #pragma once
 
+/*
+ * Level -- a grid of 16x16-pixel cells, any width and height.
+ *
+ * Cells are one byte each (Level::Cell), stored row-major from the bottom-left.
+ * In 'tilebin', levels are stored as a "lvlh" chunk of LevelHeaders plus a "lvlc" chunk
+ * holding each level's cells as a separately compressed record, so any one level
+ * can be decoded without touching the others (see pack_levels and LevelPack.hpp).
+ *
+ */
+
+#include "ChunkCodec.hpp"
+
 #include <glm/glm.hpp>
 
+#include <cstdint>
 #include <vector>
 
 struct Level {
-	bool topblocks[16][15] = { 0 };
-	bool blocks[16][15] = { 0 };
-	bool ladders[16][15] = { 0 };
-	bool hazards[16][15] = { 0 };
-	bool boxes[16][15] = { 0 }; //their starting positions
-	glm::vec2 starting_pos = glm::vec2(0.0f, 4.0f);
-};
\ No newline at end of file
+	enum Cell : uint8_t {
+		Empty = 0,
+		TopBlock,
+		Block,
+		Ladder,
+		Hazard,
+		Box, //(where a box starts)
+	};
+
+	uint32_t width = 16; //in cells
+	uint32_t height = 15;
+	std::vector< uint8_t > cells = std::vector< uint8_t >(16 * 15, Empty); //width * height
+
+	glm::vec2 starting_pos = glm::vec2(0.0f, 4.0f); //in 8-pixel tiles
+
+	//cell at (x,y) -- Empty outside the level:
+	Cell at(int32_t x, int32_t y) const {
+		if (x < 0 || y < 0 || uint32_t(x) >= width || uint32_t(y) >= height) return Empty;
+		return Cell(cells[x + y * width]);
+	}
+
+	bool operator==(Level const &other) const {
+		return width == other.width && height == other.height && starting_pos == other.starting_pos && cells == other.cells;
+	}
+	bool operator!=(Level const &other) const { return !(*this == other); }
+};
+
+//how each level is stored in tilebin's "lvlh" chunk:
+struct LevelHeader {
+	uint32_t offset = 0; //where the level's cells are stored in the "lvlc" chunk...
+	uint32_t size = 0; //...and how many bytes they take there
+	uint32_t codec = ChunkCodecRaw; //how they are stored (as for chunks, compressed records start with their decompressed size)
+	uint16_t width = 0;
+	uint16_t height = 0;
+	int16_t start_x = 0; //starting position, in 8-pixel tiles
+	int16_t start_y = 0;
+};
+static_assert(sizeof(LevelHeader) == 20, "LevelHeader is packed");
+
+//convert levels to their stored form, compressing each level's cells with 'codec' (when that makes them smaller):
+// (throws if a level is too big to store)
+void pack_levels(std::vector< Level > const &levels, ChunkCodec codec, std::vector< LevelHeader > *headers, std::vector< uint8_t > *records);
+
+//...and back (throws if the record doesn't fit in 'records_size' bytes or is corrupt):
+Level unpack_level(LevelHeader const &header, uint8_t const *records, size_t records_size);
@@ -0,0 +1,97 @@
+#include "LevelPack.hpp"
+
+#include "ChunkFile.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+constexpr uint32_t LevelPack::MaxResident;
+
+LevelPack::LevelPack(std::shared_ptr< ChunkFile const > const &file_) : file(file_) {
+	assert(file);
+	read_chunk(*file, "lvlh", &headers);
+	if (headers.empty()) throw std::runtime_error("'" + file->filename + "' has no levels.");
+	//records are decoded straight from the mapping, so the chunk holding them isn't compressed as a whole:
+	ChunkFile::Span< uint8_t > span = file->get< uint8_t >("lvlc");
+	records = span.data;
+	records_size = span.size;
+	for (LevelHeader const &header : headers) {
+		if (header.offset > records_size || header.size > records_size - header.offset) {
+			throw std::runtime_error("A level in '" + file->filename + "' runs past the end of its level data.");
+		}
+	}
+}
+
+LevelPack::~LevelPack() {
+	//(deferred decodes -- from get() -- are skipped, since waiting on them would run them)
+	for (Resident &r : resident) {
+		if (r.level.wait_for(std::chrono::seconds(0)) == std::future_status::timeout) r.level.wait();
+	}
+}
+
+std::shared_ptr< Level const > LevelPack::get(uint32_t index) {
+	if (index >= headers.size()) {
+		throw std::runtime_error("There is no level " + std::to_string(index) + " (only " + std::to_string(headers.size()) + ").");
+	}
+	return make_resident(index, std::launch::deferred).level.get();
+}
+
+void LevelPack::prefetch(uint32_t index) {
+	if (index >= headers.size()) return;
+	make_resident(index, std::launch::async);
+}
+
+LevelPack::Resident &LevelPack::make_resident(uint32_t index, std::launch policy) {
+	uses += 1;
+	for (Resident &r : resident) {
+		if (r.index == index) {
+			r.last_used = uses;
+			return r;
+		}
+	}
+
+	//make room by dropping the least recently used level that isn't still being decoded:
+	// (if every level is still being decoded, wait for the least recently used one and drop that,
+	//  since dropping the last reference to a running decode would wait for it anyway)
+	if (resident.size() >= MaxResident) {
+		auto drop = resident.end();
+		auto oldest_busy = resident.end();
+		for (auto r = resident.begin(); r != resident.end(); ++r) {
+			bool busy = r->level.wait_for(std::chrono::seconds(0)) == std::future_status::timeout;
+			auto &best = (busy ? oldest_busy : drop);
+			if (best == resident.end() || r->last_used < best->last_used) best = r;
+		}
+		if (drop == resident.end()) {
+			drop = oldest_busy;
+			drop->level.wait();
+		}
+		resident.erase(drop);
+	}
+	assert(resident.size() < MaxResident);
+
+	//(the task holds its own reference to the file, so it doesn't depend on the pack)
+	std::shared_ptr< ChunkFile const > in = file;
+	LevelHeader header = headers[index];
+	uint8_t const *data = records;
+	size_t data_size = records_size;
+	Resident r;
+	r.index = index;
+	r.last_used = uses;
+	r.level = std::async(policy, [in, header, data, data_size]() {
+		return std::shared_ptr< Level const >(new Level(unpack_level(header, data, data_size)));
+	}).share();
+	resident.emplace_back(std::move(r));
+	return resident.back();
+}
+
+bool LevelPack::same_level(uint32_t index, LevelPack const &other) const {
+	if (index >= headers.size() || index >= other.headers.size()) return false;
+	LevelHeader const &a = headers[index];
+	LevelHeader const &b = other.headers[index];
+	return a.size == b.size && a.codec == b.codec && a.width == b.width && a.height == b.height
+		&& a.start_x == b.start_x && a.start_y == b.start_y
+		&& std::memcmp(records + a.offset, other.records + b.offset, a.size) == 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+/*
+ * LevelPack -- a tilebin's levels, decoded one at a time as they are needed.
+ *
+ * Each level's cells are stored (and compressed) as a record of their own (see LevelHeader),
+ * so opening a pack only reads the small "lvlh" table. get() decodes a level the first time it is
+ * asked for, prefetch() starts decoding one on another thread ahead of time, and only the
+ * MaxResident most recently used levels are kept around (making room may wait for a prefetch
+ * to finish, if every resident level is still being decoded).
+ *
+ * //e.g.:
+ * LevelPack pack(std::make_shared< ChunkFile >(data_path("../tilebin")));
+ * std::shared_ptr< Level const > level = pack.get(3);
+ * pack.prefetch(4); //(probably next)
+ *
+ * The pack keeps the file mapped. get() and prefetch() should be called from one thread at a time.
+ *
+ */
+
+#include "Level.hpp"
+
+#include <future>
+#include <memory>
+#include <vector>
+
+struct ChunkFile;
+
+struct LevelPack {
+	//read the level table from a tilebin (throws if it is missing or malformed):
+	explicit LevelPack(std::shared_ptr< ChunkFile const > const &file);
+	~LevelPack(); //(waits for any prefetches still running)
+
+	LevelPack(LevelPack const &) = delete;
+	LevelPack &operator=(LevelPack const &) = delete;
+
+	//number of levels in the pack:
+	uint32_t size() const { return uint32_t(headers.size()); }
+
+	//level 'index', decoding it now unless it is resident (or waiting for it if it is being prefetched):
+	// (throws if the level doesn't exist or is corrupt)
+	std::shared_ptr< Level const > get(uint32_t index);
+
+	//start decoding level 'index' on another thread, unless it is already resident:
+	// (out-of-range indices are ignored; decoding errors show up when the level is get()'d)
+	void prefetch(uint32_t index);
+
+	//is level 'index' stored exactly the same way in 'other'? (compares the stored records; doesn't decode either)
+	bool same_level(uint32_t index, LevelPack const &other) const;
+
+	//levels kept decoded at once (the least recently used one is dropped to make room -- preferring ones that are done decoding):
+	static constexpr uint32_t MaxResident = 4;
+
+	//----- internals -----
+	std::shared_ptr< ChunkFile const > file;
+	std::vector< LevelHeader > headers;
+	uint8_t const *records = nullptr; //the "lvlc" chunk (used in place)
+	size_t records_size = 0;
+
+	struct Resident {
+		uint32_t index;
+		uint64_t last_used;
+		std::shared_future< std::shared_ptr< Level const > > level;
+	};
+	std::vector< Resident > resident;
+	uint64_t uses = 0; //(for least-recently-used order)
+	Resident &make_resident(uint32_t index, std::launch policy);
+};
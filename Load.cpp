@@ -1,20 +1,62 @@
 #include "Load.hpp"
 
+#include "startup_profile.hpp"
+
+#include <algorithm>
 #include <array>
-#include <list>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <cassert>
 
 namespace {
-	std::array< std::list< std::function< void() > >, MaxLoadTag > &get_load_lists() {
-		static std::array< std::list< std::function< void() > >, MaxLoadTag > load_lists;
-		return load_lists;
+	struct LoadFunction {
+		std::string name;
+		void const *key = nullptr; //(may be nullptr for tagged functions)
+		LoadThread thread = LoadOnGLThread;
+		std::vector< void const * > after; //keys of functions that must finish first
+		std::function< void() > fn;
+
+		//filled in by call_load_functions():
+		uint32_t waiting_on = 0; //unfinished dependencies
+		std::vector< uint32_t > dependents; //indices of functions waiting on this one
+		std::vector< uint32_t > dependencies; //indices of functions this one waits on
+		uint32_t record = -1U; //startup_record() id, once called
+	};
+
+	std::array< std::vector< LoadFunction >, MaxLoadTag > &get_tagged_functions() {
+		static std::array< std::vector< LoadFunction >, MaxLoadTag > tagged;
+		return tagged;
 	}
+
+	std::vector< LoadFunction > &get_keyed_functions() {
+		static std::vector< LoadFunction > keyed;
+		return keyed;
+	}
+}
+
+void add_load_function(std::string const &name, LoadTag tag, std::function< void() > const &fn, void const *key) {
+	auto &tagged = get_tagged_functions();
+	assert(tag < tagged.size());
+	LoadFunction function;
+	function.name = name;
+	function.key = key;
+	function.fn = fn;
+	tagged[tag].emplace_back(function);
 }
 
-void add_load_function(LoadTag tag, std::function< void() > const &fn) {
-	auto &load_lists = get_load_lists();
-	assert(tag < load_lists.size());
-	load_lists[tag].emplace_back(fn);
+void add_load_function(std::string const &name, void const *key, LoadThread thread, std::vector< void const * > const &after, std::function< void() > const &fn) {
+	assert(key && "keyed load functions need a key");
+	LoadFunction function;
+	function.name = name;
+	function.key = key;
+	function.thread = thread;
+	function.after = after;
+	function.fn = fn;
+	get_keyed_functions().emplace_back(function);
 }
 
 void call_load_functions() {
@@ -22,11 +64,139 @@ void call_load_functions() {
 	assert(!has_been_called && "call_load_functions should only be called *once*");
 	has_been_called = true;
 
-	auto &load_lists = get_load_lists();
-	for (auto &fn_list : load_lists) {
-		while (!fn_list.empty()) {
-			(*fn_list.begin())(); //call first function in the list
-			fn_list.pop_front(); //remove from list
+	//gather everything into one graph:
+	std::vector< LoadFunction > functions;
+	std::vector< uint32_t > previous_tag; //tagged functions with the last non-empty tag
+	for (auto &tag_functions : get_tagged_functions()) {
+		std::vector< uint32_t > this_tag;
+		for (auto &function : tag_functions) {
+			//tagged functions wait for all tagged functions of the previous (non-empty) tag:
+			// (which, in turn, waited for the tag before that)
+			uint32_t index = uint32_t(functions.size());
+			for (uint32_t p : previous_tag) {
+				function.waiting_on += 1;
+				function.dependencies.emplace_back(p);
+				functions[p].dependents.emplace_back(index);
+			}
+			functions.emplace_back(std::move(function));
+			this_tag.emplace_back(index);
 		}
+		if (!this_tag.empty()) previous_tag = std::move(this_tag);
+		tag_functions.clear();
 	}
+	for (auto &function : get_keyed_functions()) {
+		functions.emplace_back(std::move(function));
+	}
+	get_keyed_functions().clear();
+	//(tagged Load<>s have keys too, so keyed functions can wait on them)
+	std::unordered_map< void const *, uint32_t > by_key;
+	for (uint32_t i = 0; i < functions.size(); ++i) {
+		if (functions[i].key) by_key.emplace(functions[i].key, i);
+	}
+	for (uint32_t i = 0; i < functions.size(); ++i) {
+		for (void const *key : functions[i].after) {
+			auto f = by_key.find(key);
+			if (f == by_key.end()) {
+				throw std::runtime_error("Load function '" + functions[i].name + "' depends on a Load<> that was never registered.");
+			}
+			functions[i].waiting_on += 1;
+			functions[i].dependencies.emplace_back(f->second);
+			functions[f->second].dependents.emplace_back(i);
+		}
+	}
+
+	//run the graph: OpenGL functions on this thread, others on whichever thread is free:
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque< uint32_t > gl_ready, any_ready; //<-- guarded by mutex
+	uint32_t remaining = uint32_t(functions.size()); //<-- guarded by mutex
+	uint32_t running = 0; //<-- guarded by mutex
+	std::exception_ptr error; //<-- guarded by mutex
+
+	auto make_ready = [&](uint32_t i) {
+		(functions[i].thread == LoadOnGLThread ? gl_ready : any_ready).emplace_back(i);
+	};
+	for (uint32_t i = 0; i < functions.size(); ++i) {
+		if (functions[i].waiting_on == 0) make_ready(i);
+	}
+
+	//call function 'i' (mutex held on entry and exit):
+	auto run = [&](uint32_t i, std::unique_lock< std::mutex > &lock) {
+		running += 1;
+		lock.unlock();
+		std::exception_ptr failed;
+		TraceClock::time_point start = TraceClock::now();
+		uint64_t bytes = startup_bytes_read();
+		try {
+			functions[i].fn();
+		} catch (...) {
+			failed = std::current_exception();
+		}
+		TraceClock::time_point end = TraceClock::now();
+		bytes = startup_bytes_read() - bytes;
+		lock.lock();
+		std::vector< uint32_t > after;
+		for (uint32_t d : functions[i].dependencies) {
+			after.emplace_back(functions[d].record);
+		}
+		functions[i].record = startup_record(functions[i].name, "load", start, end, bytes, after);
+		running -= 1;
+		remaining -= 1;
+		if (failed) {
+			if (!error) error = failed;
+		} else {
+			for (uint32_t d : functions[i].dependents) {
+				functions[d].waiting_on -= 1;
+				if (functions[d].waiting_on == 0) make_ready(d);
+			}
+		}
+		changed.notify_all();
+	};
+
+	//worker threads only exist if there is something for them to do:
+	std::vector< std::thread > workers;
+	uint32_t any_count = uint32_t(std::count_if(functions.begin(), functions.end(), [](LoadFunction const &f){ return f.thread == LoadOnAnyThread; }));
+	uint32_t cores = std::thread::hardware_concurrency(); //(this thread counts as one)
+	uint32_t worker_count = std::min(any_count, cores > 1 ? cores - 1 : 1U);
+	bool done = false; //<-- guarded by mutex
+	for (uint32_t w = 0; w < worker_count; ++w) {
+		workers.emplace_back([&,w](){
+			trace_thread_name("load worker " + std::to_string(w));
+			std::unique_lock< std::mutex > lock(mutex);
+			while (true) {
+				changed.wait(lock, [&](){ return done || (!error && !any_ready.empty()); });
+				if (done) break;
+				uint32_t i = any_ready.front();
+				any_ready.pop_front();
+				run(i, lock);
+			}
+		});
+	}
+
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		while (remaining > 0 && !(error && running == 0)) {
+			if (!error && !gl_ready.empty()) {
+				uint32_t i = gl_ready.front();
+				gl_ready.pop_front();
+				run(i, lock);
+			} else if (!error && !any_ready.empty()) {
+				//(help out rather than wait)
+				uint32_t i = any_ready.front();
+				any_ready.pop_front();
+				run(i, lock);
+			} else if (running == 0 && !error && gl_ready.empty() && any_ready.empty()) {
+				error = std::make_exception_ptr(std::runtime_error("Load functions have circular dependencies."));
+			} else {
+				changed.wait(lock);
+			}
+		}
+		done = true;
+		changed.notify_all();
+	}
+	for (auto &worker : workers) {
+		worker.join();
+	}
+
+	if (error) std::rethrow_exception(error);
 }
@@ -6,7 +6,7 @@
  * This is useful for global-scope resources that need an OpenGL context:
  *
  * //at global scope:
- * Load< Mesh > main_mesh([]() -> const Mesh * {
+ * Load< Mesh > main_mesh("main mesh", LoadTagDefault, []() -> const Mesh * {
  *     return &Meshes.get("Main");
  * });
  *
@@ -20,10 +20,23 @@
  * These functions are grouped by 'tags', which allow some sequencing of calls.
  * (particularly, this is useful for loading large data blobs [e.g. Meshes] before looking up individual elements within them.)
  *
+ * Instead of a tag, a Load<> can list the other Load<>s it needs; it is then called as soon as those are done.
+ * Load functions that don't touch OpenGL can say so, and are run on worker threads alongside everything else:
+ *
+ * Load< Blob > blob("big blob", LoadOnAnyThread, { }, []() -> const Blob * { return new Blob(data_path("big.blob")); });
+ * Load< Mesh > main_mesh("main mesh", LoadOnGLThread, { &blob }, []() -> const Mesh * { return new Mesh(*blob, "Main"); });
+ *
+ * The name is used in the startup profile report (see startup_profile.hpp).
+ *
+ * Tagged load functions keep their old behavior: they run on the OpenGL thread, after every tagged function with an earlier tag.
+ * A tagged Load<> can still be listed in another Load<>'s 'after' list.
+ *
  */
 
 #include <functional>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 enum LoadTag : uint32_t {
 	LoadTagEarly,
@@ -32,12 +45,23 @@ enum LoadTag : uint32_t {
 	MaxLoadTag //<-- just used to track # of load tags
 };
 
+enum LoadThread : uint32_t {
+	LoadOnGLThread, //function uses OpenGL (or anything else that must happen on the main thread)
+	LoadOnAnyThread, //function may run on a worker thread, at the same time as other load functions
+};
+
 //Add a function to an internal list of loading functions:
 // (only call *before* "call_load_functions()")
-void add_load_function(LoadTag tag, std::function< void() > const &fn);
+// ('key', if given, lets keyed load functions list this one in their 'after' lists)
+void add_load_function(std::string const &name, LoadTag tag, std::function< void() > const &fn, void const *key = nullptr);
+
+//Add a function that is called once all the functions registered with keys in 'after' have finished:
+// (keys are usually the addresses of Load<> objects; they need not be registered yet when this is called)
+void add_load_function(std::string const &name, void const *key, LoadThread thread, std::vector< void const * > const &after, std::function< void() > const &fn);
 
 //Call all loading functions:
-// (loading functions may throw exceptions if they fail.)
+// (loading functions may throw exceptions if they fail; the first exception is re-thrown here once running functions finish)
+// (throws if dependencies are missing or circular)
 // (only call *once*)
 void call_load_functions();
 
@@ -49,8 +73,18 @@ T const *new_T() { return new T; }
 template< typename T >
 struct Load {
 	//Constructing a Load< T > adds the passed function to the list of functions to call:
-	Load(LoadTag tag, const std::function< T const *() > &load_fn = new_T< T >) : value(nullptr) {
-		add_load_function(tag, [this,load_fn](){
+	Load(std::string const &name, LoadTag tag, const std::function< T const *() > &load_fn = new_T< T >) : value(nullptr) {
+		add_load_function(name, tag, [this,load_fn](){
+			this->value = load_fn();
+			if (!(this->value)) {
+				throw std::runtime_error("Loading failed.");
+			}
+		}, this);
+	}
+
+	//...or call it once the Load<>s listed in 'after' are loaded:
+	Load(std::string const &name, LoadThread thread, std::vector< void const * > const &after, const std::function< T const *() > &load_fn = new_T< T >) : value(nullptr) {
+		add_load_function(name, this, thread, after, [this,load_fn](){
 			this->value = load_fn();
 			if (!(this->value)) {
 				throw std::runtime_error("Loading failed.");
@@ -73,8 +107,11 @@ struct Load {
 template< >
 struct Load< void > {
 	//Constructing a Load< T > adds the passed function to the list of functions to call:
-	Load( LoadTag tag, const std::function< void() > &load_fn) {
-		add_load_function(tag, load_fn);
+	Load( std::string const &name, LoadTag tag, const std::function< void() > &load_fn) {
+		add_load_function(name, tag, load_fn, this);
+	}
+	Load( std::string const &name, LoadThread thread, std::vector< void const * > const &after, const std::function< void() > &load_fn) {
+		add_load_function(name, this, thread, after, load_fn);
 	}
 };
 
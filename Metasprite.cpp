@@ -0,0 +1,176 @@
+#include "Metasprite.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace {
+	bool on_screen(int32_t x, int32_t y) {
+		//(sprites can't be placed off the left or bottom edge, so partly visible pieces there are skipped too)
+		return x >= 0 && x < int32_t(PPU466::ScreenWidth) && y >= 0 && y < int32_t(PPU466::ScreenHeight);
+	}
+}
+
+void SpriteBatch::begin(uint32_t slots_) {
+	assert(slots_ <= Slots);
+	if (slots_ != slots) {
+		//(slots past the end may be changed by someone else, so they are rewritten -- or hidden -- when they come back)
+		for (uint32_t s = std::min(slots, slots_); s < Slots; ++s) drawn_valid[s] = false;
+		used = (slots_ > slots ? slots_ : std::min(used, slots_));
+	}
+	slots = slots_;
+	submission_count = 0;
+	overflow = 0;
+}
+
+void SpriteBatch::submit(Metasprite const &metasprite, uint8_t tile, int32_t x, int32_t y, uint8_t flags, uint8_t priority) {
+	if (submission_count == MaxSubmissions) {
+		overflow += 1;
+		return;
+	}
+	Submission &s = submissions[submission_count++];
+	s.metasprite = &metasprite;
+	s.x = x;
+	s.y = y;
+	s.tile = tile;
+	s.flags = flags;
+	s.priority = priority;
+}
+
+void SpriteBatch::end(PPU466 *ppu, std::vector< int > const &tile_to_palette_map) {
+	assert(ppu);
+	stats = Stats();
+	stats.submitted = submission_count;
+
+	//count each submission's on-screen pieces:
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < submission_count; ++i) {
+		Submission const &s = submissions[i];
+		Metasprite const &m = *s.metasprite;
+		uint32_t count = 0;
+		for (uint32_t p = 0; p < m.count; ++p) {
+			if (on_screen(s.x + m.pieces[p].x, s.y + m.pieces[p].y)) count += 1;
+		}
+		visible[i] = uint16_t(std::min(count, uint32_t(0xffff)));
+		total += visible[i];
+	}
+	stats.pieces = total;
+
+	//decide what to show (usually everything):
+	if (total <= slots) {
+		std::fill(shown.begin(), shown.begin() + submission_count, true);
+	} else {
+		choose();
+	}
+
+	//place what is shown in submission order (so slots stay put from frame to frame while nothing changes):
+	uint32_t slot = 0;
+	for (uint32_t i = 0; i < submission_count; ++i) {
+		if (visible[i] == 0) continue;
+		if (!shown[i]) {
+			stats.dropped += visible[i];
+			continue;
+		}
+		Submission const &s = submissions[i];
+		Metasprite const &m = *s.metasprite;
+		assert(slot + visible[i] <= slots);
+
+		if (!(drawn_valid[slot] && drawn[slot] == s)) {
+			uint32_t at = slot;
+			for (uint32_t p = 0; p < m.count; ++p) {
+				MetaspritePiece const &piece = m.pieces[p];
+				int32_t x = s.x + piece.x;
+				int32_t y = s.y + piece.y;
+				if (!on_screen(x, y)) continue;
+				uint8_t tile = uint8_t(s.tile + piece.tile);
+				PPU466::Sprite &sprite = ppu->sprites[at];
+				sprite.x = uint8_t(x);
+				sprite.y = uint8_t(y);
+				sprite.index = tile;
+				sprite.attributes = uint8_t((tile < tile_to_palette_map.size() ? tile_to_palette_map[tile] : 0) | (s.flags & MetaspriteBehind));
+				drawn_valid[at] = false;
+				at += 1;
+			}
+			drawn[slot] = s;
+			drawn_valid[slot] = true;
+			stats.written += visible[i];
+		}
+		slot += visible[i];
+	}
+	//dropped for lack of room in the submission list count as one sprite each (they were never looked at):
+	stats.dropped += overflow;
+
+	//hide slots that were used last frame but not this one:
+	for (uint32_t s = slot; s < used; ++s) {
+		ppu->sprites[s].y = 240;
+		drawn_valid[s] = false;
+	}
+	used = slot;
+
+	if (stats.dropped > worst_dropped) {
+		worst_dropped = stats.dropped;
+		std::cerr << "WARNING: " << stats.dropped << " sprites didn't fit in the " << slots << " hardware sprites this frame ("
+			<< stats.pieces << " on screen from " << stats.submitted << " metasprites)"
+			<< (time_slice ? "; the lowest priority on screen takes turns." : ".") << std::endl;
+	}
+}
+
+void SpriteBatch::choose() {
+	//sort by priority, highest first (a counting sort, so it is linear in the number of submissions):
+	std::array< uint32_t, 257 > starts;
+	starts.fill(0);
+	for (uint32_t i = 0; i < submission_count; ++i) {
+		starts[255 - submissions[i].priority + 1] += 1;
+	}
+	for (uint32_t p = 1; p < starts.size(); ++p) starts[p] += starts[p-1];
+	for (uint32_t i = 0; i < submission_count; ++i) {
+		order[starts[255 - submissions[i].priority]++] = uint16_t(i);
+	}
+	//(starts[p] is now the end of priority 255-p's run)
+
+	std::fill(shown.begin(), shown.begin() + submission_count, false);
+	uint32_t free = slots;
+	uint32_t at = 0;
+	while (at < submission_count) {
+		//the run of submissions with the same priority:
+		uint32_t begin = at;
+		uint32_t end = starts[255 - submissions[order[at]].priority];
+		at = end;
+
+		uint32_t wanted = 0;
+		for (uint32_t o = begin; o < end; ++o) wanted += visible[order[o]];
+		if (wanted <= free) {
+			for (uint32_t o = begin; o < end; ++o) shown[order[o]] = true;
+			free -= wanted;
+			continue;
+		}
+
+		//this priority doesn't all fit: take turns (or, without time slicing, favor submission order),
+		// then let anything lower that still fits fill the gaps:
+		uint32_t count = end - begin;
+		uint32_t first = (time_slice ? slice_start % count : 0);
+		uint32_t taken = 0;
+		for (uint32_t k = 0; k < count; ++k) {
+			uint32_t i = order[begin + (first + k) % count];
+			if (visible[i] <= free) {
+				shown[i] = true;
+				free -= visible[i];
+				taken = k + 1;
+			}
+		}
+		slice_start = (first + taken) % count; //(next frame starts just after the last one shown)
+		for (uint32_t o = end; o < submission_count; ++o) {
+			uint32_t i = order[o];
+			if (visible[i] <= free) {
+				shown[i] = true;
+				free -= visible[i];
+			}
+		}
+		break;
+	}
+}
+
+void SpriteBatch::invalidate() {
+	drawn_valid.fill(false);
+	used = slots; //(hide everything not used next frame)
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+/*
+ * Metasprites -- objects drawn with several 8x8 PPU466 sprites -- and SpriteBatch, which packs them into the hardware sprites.
+ *
+ * A Metasprite is a list of pieces (an offset and a tile, relative to the metasprite's position and tile),
+ * usually defined at compile time:
+ *
+ * constexpr MetaspritePiece CatPieces[] = { {0,0,0}, {8,0,1}, {0,8,2}, {8,8,3} };
+ * constexpr Metasprite Cat = metasprite(CatPieces);
+ *
+ * Each frame, metasprites are submitted to a SpriteBatch, which hands out hardware sprite slots in submission order:
+ *
+ * batch.begin();
+ * batch.submit(Cat, tile, x, y); //(for each object)
+ * batch.end(&ppu, tile_to_palette_map);
+ *
+ * Pieces that are off screen don't use a slot. When there are more pieces on screen than slots,
+ * the batch multiplexes: higher-priority submissions are placed first, and (if time_slice is set) the
+ * lowest priority that only partly fits takes turns from frame to frame -- they flicker, but every object
+ * shows up. Metasprites are always shown or left out whole. Choosing costs a counting sort on priority
+ * and one pass over the submissions, so it stays linear however crowded the screen gets.
+ *
+ * A submission identical to the one that started in the same slot last frame isn't rewritten.
+ *
+ */
+
+#include "PPU466.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+struct MetaspritePiece {
+	int8_t x; //pixels right of the metasprite's position
+	int8_t y; //pixels above the metasprite's position
+	uint8_t tile; //added to the tile given to submit()
+};
+
+struct Metasprite {
+	MetaspritePiece const *pieces;
+	uint32_t count;
+};
+
+template< size_t N >
+constexpr Metasprite metasprite(MetaspritePiece const (&pieces)[N]) {
+	return Metasprite{ pieces, uint32_t(N) };
+}
+
+//a 16x16 object made of four tiles, in the order process_assets slices them (bottom row first, then left to right):
+constexpr MetaspritePiece Metasprite16x16Pieces[] = { {0,0,0}, {8,0,1}, {0,8,2}, {8,8,3} };
+constexpr Metasprite Metasprite16x16 = metasprite(Metasprite16x16Pieces);
+
+//flags for submit():
+enum MetaspriteFlags : uint8_t {
+	MetaspriteBehind = 0x80, //drawn behind the background (the sprite 'priority' bit)
+};
+
+struct SpriteBatch {
+	enum : uint32_t {
+		Slots = std::tuple_size< decltype(PPU466::sprites) >::value,
+		MaxSubmissions = 1024, //(submissions past this are dropped)
+	};
+
+	//start a frame, using hardware sprites [0, slots) (the rest are left alone, e.g., for an overlay):
+	void begin(uint32_t slots = Slots);
+
+	//draw 'metasprite' with its pieces' tiles offset by 'tile' and its lower left at screen position (x, y):
+	// (when there isn't room for everything, higher 'priority' goes first)
+	void submit(Metasprite const &metasprite, uint8_t tile, int32_t x, int32_t y, uint8_t flags = 0, uint8_t priority = 0);
+
+	//when not everything fits, cycle through the submissions that don't (rather than always dropping the same ones):
+	bool time_slice = true;
+
+	//pack this frame's submissions into ppu->sprites (hiding slots no longer used):
+	// (palettes come from tile_to_palette_map; prints a warning when a frame leaves out more sprites than any before it)
+	void end(PPU466 *ppu, std::vector< int > const &tile_to_palette_map);
+
+	//forget what is in ppu->sprites (call after something else changes them, or after palettes change):
+	void invalidate();
+
+	//last frame's counts:
+	struct Stats {
+		uint32_t submitted = 0; //metasprites
+		uint32_t pieces = 0; //sprites that were on screen
+		uint32_t written = 0; //sprites written (not skipped as unchanged)
+		uint32_t dropped = 0; //sprites that didn't fit (left out this frame)
+	} stats;
+	uint32_t worst_dropped = 0; //most sprites dropped in any frame so far
+
+	//----- internals -----
+	struct Submission {
+		Metasprite const *metasprite = nullptr;
+		int32_t x = 0;
+		int32_t y = 0;
+		uint8_t tile = 0;
+		uint8_t flags = 0;
+		uint8_t priority = 0; //(not compared: it decides whether a submission is shown, not what it looks like)
+		bool operator==(Submission const &o) const {
+			return metasprite == o.metasprite && x == o.x && y == o.y && tile == o.tile && flags == o.flags;
+		}
+	};
+	std::array< Submission, MaxSubmissions > submissions;
+	uint32_t submission_count = 0;
+	uint32_t slots = Slots; //this frame's
+	uint32_t overflow = 0; //submissions dropped for lack of room in 'submissions'
+
+	//multiplexing:
+	std::array< uint16_t, MaxSubmissions > visible; //on-screen pieces of each submission
+	std::array< bool, MaxSubmissions > shown; //chosen to be drawn this frame
+	std::array< uint16_t, MaxSubmissions > order; //submissions sorted by priority
+	uint32_t slice_start = 0; //where the next frame's turn-taking starts (counted within the group that takes turns)
+	void choose(); //set 'shown' when the visible pieces don't all fit
+
+	//what was written to each slot (valid only for the first slot of each submission):
+	std::array< Submission, Slots > drawn;
+	std::array< bool, Slots > drawn_valid = {};
+	uint32_t used = 0; //slots in use after the last end()
+};
@@ -4,10 +4,13 @@
 #include "GL.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
+#include "gl_profile.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
 #include <vector>
+#include <cstring>
+#include <cassert>
 
 //In order to implement the PPU466 on modern graphics hardware, a fancy, special purpose tile-drawing shader is used:
 struct PPUTileProgram {
@@ -18,19 +21,19 @@ struct PPUTileProgram {
 
 	//Attribute (per-vertex variable) locations:
 	GLuint Position_vec2 = -1U;
-	GLuint TileCoord_ivec2 = -1U;
+	GLuint TileCoord_ivec3 = -1U;
 	GLuint Palette_int = -1U;
 
 	//Uniform (per-invocation variable) locations:
 	GLuint OBJECT_TO_CLIP_mat4 = -1U;
 
 	//Textures bindings:
-	//TEXTURE0 - the tile table (as a 128x128 R8UI texture)
-	//TEXTURE1 - the palette table (as a 4x8 RGBA8 texture)
+	//TEXTURE0 - the tile table (as a 128x128xTileLayers R8UI texture array)
+	//TEXTURE1 - the palette table (as a 4xPaletteCount RGBA8 texture)
 };
 
 //Initialize tile program and associated buffers:
-Load< PPUTileProgram > tile_program(LoadTagEarly); //will 'new PPUTileProgram()' by default
+Load< PPUTileProgram > tile_program("PPU tile program", LoadOnGLThread, { }); //will 'new PPUTileProgram()' by default
 
 //PPU data is streamed to the GPU (read: uploaded 'just in time') using a few buffers:
 struct PPUDataStream {
@@ -39,12 +42,12 @@ struct PPUDataStream {
 
 	//vertex format for convenience:
 	struct Vertex {
-		Vertex(glm::ivec2 const &Position_, glm::ivec2 const &TileCoord_, int32_t const &Palette_)
+		Vertex(glm::ivec2 const &Position_, glm::ivec3 const &TileCoord_, int32_t const &Palette_)
 			: Position(Position_), TileCoord(TileCoord_), Palette(Palette_) { }
 		//I generally make class members lowercase, but I make an exception here because
 		// I use uppercase for vertex attributes in shader programs and want to match.
 		glm::ivec2 Position;
-		glm::ivec2 TileCoord;
+		glm::ivec3 TileCoord; //(x, y, layer)
 		int32_t Palette;
 	};
 
@@ -54,18 +57,26 @@ struct PPUDataStream {
 	//vertex array object that maps tile program attributes to vertex storage:
 	GLuint vertex_buffer_for_tile_program = 0;
 
-	//texture object that will store tile table:
+	//texture array object that will store tile table:
+	// (shared by all PPU modes; re-allocated when a mode with a different number of layers draws)
 	GLuint tile_tex = 0;
+	mutable uint32_t tile_tex_layers = 1;
+
+	//the tile table that tile_tex currently holds, so it is only re-built when tiles change:
+	// (mutable because uploading doesn't change what the stream *is*, just what it caches)
+	mutable std::vector< PPUTile > tile_tex_contents;
+	mutable bool tile_tex_valid = false;
 
 	//texture object that will store palette table:
 	GLuint palette_tex = 0;
 };
 
-Load< PPUDataStream > data_stream(LoadTagDefault);
+Load< PPUDataStream > data_stream("PPU data stream", LoadOnGLThread, { &tile_program }); //(vertex array uses tile_program's attribute locations)
 
 //-------------------------------------------------------------------
 
-PPU466::PPU466() {
+template< uint32_t T, uint32_t P, uint32_t S, uint32_t W, uint32_t H >
+PPU< T, P, S, W, H >::PPU() {
 	for (auto &palette : palette_table) {
 		palette[0] = glm::u8vec4(0x00, 0x00, 0x00, 0x00);
 		palette[1] = glm::u8vec4(0x44, 0x44, 0x44, 0xff);
@@ -79,14 +90,78 @@ PPU466::PPU466() {
 	}
 
 	for (uint32_t i = 0; i < background.size(); ++i) {
-		background[i] = int16_t(
-			  (i % 8) << 8 //cycle through all palettes
+		background[i] = BackgroundEntry(
+			  (i % PaletteCount) << PaletteShift //cycle through all palettes
 			| (i % palette_table.size()) //cycle through all tiles
 		);
 	}
 }
 
-void PPU466::draw(glm::uvec2 const &drawable_size) const {
+template< uint32_t T, uint32_t P, uint32_t S, uint32_t W, uint32_t H >
+void PPU< T, P, S, W, H >::save_state(State *state_) const {
+	assert(state_);
+	State &state = *state_;
+	state.background_color = background_color;
+	state.palette_table = palette_table;
+	state.tile_table = tile_table;
+	state.background = background;
+	state.background_position = background_position;
+	state.sprites = sprites;
+}
+
+template< uint32_t T, uint32_t P, uint32_t S, uint32_t W, uint32_t H >
+void PPU< T, P, S, W, H >::load_state(State const &state) {
+	background_color = state.background_color;
+	palette_table = state.palette_table;
+	tile_table = state.tile_table;
+	background = state.background;
+	background_position = state.background_position;
+	sprites = state.sprites;
+}
+
+template< uint32_t T, uint32_t P, uint32_t S, uint32_t W, uint32_t H >
+void PPU< T, P, S, W, H >::draw_loading(glm::uvec2 const &drawable_size, float progress, glm::u8vec3 bar_color) const {
+	glClearColor(
+		background_color.r / 255.0f,
+		background_color.g / 255.0f,
+		background_color.b / 255.0f,
+		1.0f
+	);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	//same placement as draw() (integer-multiple scaling, centered):
+	uint32_t scale = 1;
+	glm::ivec2 lower_left = glm::ivec2(0);
+	if (drawable_size.x >= ScreenWidth && drawable_size.y >= ScreenHeight) {
+		scale = std::max( 1U, std::min(drawable_size.x / ScreenWidth, drawable_size.y / ScreenHeight) );
+		lower_left = glm::ivec2(
+			(int32_t(drawable_size.x) - scale * int32_t(ScreenWidth)) / 2,
+			(int32_t(drawable_size.y) - scale * int32_t(ScreenHeight)) / 2
+		);
+	}
+
+	//bar is drawn by clearing scissored rectangles, so no program or textures are needed:
+	constexpr int32_t BarX = 64, BarY = 116, BarWidth = 128, BarHeight = 8;
+	auto fill = [&](int32_t x, int32_t y, int32_t w, int32_t h, glm::vec3 const &color) {
+		glScissor(lower_left.x + x * scale, lower_left.y + y * scale, w * scale, h * scale);
+		glClearColor(color.r, color.g, color.b, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+	};
+	glm::vec3 bar = glm::vec3(bar_color) / 255.0f;
+	glm::vec3 background = glm::vec3(background_color) / 255.0f;
+	glEnable(GL_SCISSOR_TEST);
+	fill(BarX - 1, BarY - 1, BarWidth + 2, BarHeight + 2, bar); //outline
+	fill(BarX, BarY, BarWidth, BarHeight, background);
+	fill(BarX, BarY, int32_t(BarWidth * std::max(0.0f, std::min(1.0f, progress)) + 0.5f), BarHeight, bar);
+	glDisable(GL_SCISSOR_TEST);
+
+	GL_ERRORS();
+}
+
+template< uint32_t T, uint32_t P, uint32_t S, uint32_t W, uint32_t H >
+void PPU< T, P, S, W, H >::draw(glm::uvec2 const &drawable_size) const {
+	PROFILE_SCOPE("PPU::draw");
+
 	//this code does screen scaling by manipulating the viewport, so save old values:
 	GLint old_viewport[4];
 	glGetIntegerv(GL_VIEWPORT, old_viewport);
@@ -122,118 +197,123 @@ void PPU466::draw(glm::uvec2 const &drawable_size) const {
 
 	//build triangle strip representing background and sprites:
 
-	constexpr uint32_t TristripSize = uint32_t(6 * (BackgroundWidth * BackgroundHeight + decltype(sprites)().size()));
-	std::vector< PPUDataStream::Vertex > triangle_strip;
-	triangle_strip.reserve(TristripSize);
-
-	//helper to put a single tile somewhere on the screen:
-	auto draw_tile = [&triangle_strip](glm::ivec2 const &lower_left, uint8_t tile_index, uint8_t palette_index){
-		//convert tile index to lower-left pixel coordinate in tile image:
-		glm::ivec2 tile_coord = glm::ivec2((tile_index % 16)*8, (tile_index / 16)*8);
-
-		//build a quad as a (very short) triangle strip that starts and ends with degenerate triangles:
-		triangle_strip.emplace_back(glm::ivec2(lower_left.x+0, lower_left.y+0), glm::ivec2(tile_coord.x+0, tile_coord.y+0), palette_index);
-		triangle_strip.emplace_back(triangle_strip.back());
-		triangle_strip.emplace_back(glm::ivec2(lower_left.x+0, lower_left.y+8), glm::ivec2(tile_coord.x+0, tile_coord.y+8), palette_index);
-		triangle_strip.emplace_back(glm::ivec2(lower_left.x+8, lower_left.y+0), glm::ivec2(tile_coord.x+8, tile_coord.y+0), palette_index);
-		triangle_strip.emplace_back(glm::ivec2(lower_left.x+8, lower_left.y+8), glm::ivec2(tile_coord.x+8, tile_coord.y+8), palette_index);
-		triangle_strip.emplace_back(triangle_strip.back());
-	};
-
-	//helper to draw the sprite list (used because we need to draw the 'behind' sprites, then the background, then the 'front' sprites:
-	auto draw_sprites = [this,&draw_tile](uint8_t priority) {
-		for (auto const &sprite : sprites) {
-			if ((sprite.attributes & 0x80) != priority) continue;
-			draw_tile(
-				glm::ivec2(sprite.x, sprite.y),
-				sprite.index,
-				sprite.attributes & 0x07 //just the palette index part
-			);
-		}
-	};
+	//the background tiles that can overlap the screen:
+	constexpr int32_t VisibleWidth = int32_t(ScreenWidth) / 8 + 1;
+	constexpr int32_t VisibleHeight = int32_t(ScreenHeight) / 8 + 1;
 
-	draw_sprites(0x80); //draw sprites with priority == 1 ('behind' sprites)
-
-	{ //draw the background:
-		//To simulate the 'infinite tiling' behavior this code draws the background as four screen-sized chunks,
-		// each of which is drawn at an offset that causes it to overlap the screen.
-
-		static_assert(BackgroundWidth * 8 == ScreenWidth * 2, "Background should be exactly twice the screen width.");
-		static_assert(BackgroundHeight * 8 == ScreenHeight * 2, "Background should be exactly twice the screen height.");
-
-		for (int32_t chunk_y : {0, int32_t(ScreenHeight)}) {
-			for (int32_t chunk_x : {0, int32_t(ScreenWidth)}) {
-				//position of the lower-left corner of the chunk:
-				glm::ivec2 pos = glm::ivec2(chunk_x, chunk_y) + background_position;
-
-				constexpr int32_t BackgroundWidthPixels = int32_t(BackgroundWidth) * 8;
-				constexpr int32_t BackgroundHeightPixels = int32_t(BackgroundHeight) * 8;
-
-				//reduce to (-BackgroundWidthPixels,0] x (-BackgroundHeightPixels,0]:
-				pos.x = ((pos.x % BackgroundWidthPixels) - BackgroundWidthPixels) % BackgroundWidthPixels;
-				pos.y = ((pos.y % BackgroundHeightPixels) - BackgroundHeightPixels) % BackgroundHeightPixels;
-
-				//move chunk if it doesn't overlap the screen:
-				if (pos.x + int32_t(ScreenWidth) <= 0) pos.x += BackgroundWidthPixels;
-				if (pos.y + int32_t(ScreenHeight) <= 0) pos.y += BackgroundHeightPixels;
-
-				int32_t ox = chunk_x / 8;
-				int32_t oy = chunk_y / 8;
-				for (int32_t y = 0; y < int32_t(BackgroundHeight)/2; ++y) {
-					for (int32_t x = 0; x < int32_t(BackgroundWidth)/2; ++x) {
-						uint16_t info = background[(x + ox) + BackgroundWidth * (y + oy)];
-						draw_tile(
-							glm::ivec2(pos.x + 8*x, pos.y + 8*y),
-							info & 0xff, //extract tile index bits
-							(info >> 8) & 0x07 //extract palette index bits
-						);
-					}
+	constexpr uint32_t TristripSize = uint32_t(6 * (VisibleWidth * VisibleHeight + SpriteCount));
+	std::vector< PPUDataStream::Vertex > triangle_strip;
+	{ //fill triangle strip:
+		PROFILE_SCOPE("build vertices");
+
+		triangle_strip.reserve(TristripSize);
+
+		//helper to put a single tile somewhere on the screen:
+		auto draw_tile = [&triangle_strip](glm::ivec2 const &lower_left, uint32_t tile_index, uint32_t palette_index){
+			//convert tile index to lower-left pixel coordinate (and layer) in tile images:
+			glm::ivec3 tile_coord = glm::ivec3((tile_index % 16)*8, ((tile_index / 16) % 16)*8, tile_index / 256);
+
+			//build a quad as a (very short) triangle strip that starts and ends with degenerate triangles:
+			triangle_strip.emplace_back(glm::ivec2(lower_left.x+0, lower_left.y+0), glm::ivec3(tile_coord.x+0, tile_coord.y+0, tile_coord.z), palette_index);
+			triangle_strip.emplace_back(triangle_strip.back());
+			triangle_strip.emplace_back(glm::ivec2(lower_left.x+0, lower_left.y+8), glm::ivec3(tile_coord.x+0, tile_coord.y+8, tile_coord.z), palette_index);
+			triangle_strip.emplace_back(glm::ivec2(lower_left.x+8, lower_left.y+0), glm::ivec3(tile_coord.x+8, tile_coord.y+0, tile_coord.z), palette_index);
+			triangle_strip.emplace_back(glm::ivec2(lower_left.x+8, lower_left.y+8), glm::ivec3(tile_coord.x+8, tile_coord.y+8, tile_coord.z), palette_index);
+			triangle_strip.emplace_back(triangle_strip.back());
+		};
+
+		//helper to draw the sprite list (used because we need to draw the 'behind' sprites, then the background, then the 'front' sprites:
+		auto draw_sprites = [this,&draw_tile](uint8_t priority) {
+			for (auto const &sprite : sprites) {
+				if ((sprite.attributes & 0x80) != priority) continue;
+				draw_tile(
+					glm::ivec2(sprite.x, sprite.y),
+					sprite.index,
+					sprite.attributes & (PaletteCount - 1) //just the palette index part
+				);
+			}
+		};
+
+		draw_sprites(0x80); //draw sprites with priority == 1 ('behind' sprites)
+
+		{ //draw the background:
+			//Only the background tiles that overlap the screen are drawn, starting from the tile under the
+			// screen's lower-left corner and wrapping around the edges of the background (which simulates its 'infinite tiling').
+
+			constexpr int32_t BackgroundWidthPixels = int32_t(BackgroundWidth) * 8;
+			constexpr int32_t BackgroundHeightPixels = int32_t(BackgroundHeight) * 8;
+
+			//background pixel under screen pixel (0,0), reduced to [0,BackgroundWidthPixels) x [0,BackgroundHeightPixels):
+			glm::ivec2 origin = -background_position;
+			origin.x = ((origin.x % BackgroundWidthPixels) + BackgroundWidthPixels) % BackgroundWidthPixels;
+			origin.y = ((origin.y % BackgroundHeightPixels) + BackgroundHeightPixels) % BackgroundHeightPixels;
+
+			//the first tile starts this far below / left of the screen's corner:
+			glm::ivec2 shift = glm::ivec2(origin.x % 8, origin.y % 8);
+
+			for (int32_t y = 0; y < VisibleHeight; ++y) {
+				uint32_t ty = uint32_t(origin.y / 8 + y) % BackgroundHeight;
+				for (int32_t x = 0; x < VisibleWidth; ++x) {
+					uint32_t tx = uint32_t(origin.x / 8 + x) % BackgroundWidth;
+					BackgroundEntry info = background[tx + BackgroundWidth * ty];
+					draw_tile(
+						glm::ivec2(8*x - shift.x, 8*y - shift.y),
+						info & (TileCount - 1), //extract tile index bits
+						(info >> PaletteShift) & (PaletteCount - 1) //extract palette index bits
+					);
 				}
-
 			}
 		}
-	}
 
-	draw_sprites(0x00); //draw sprites with priority == 0 ('in front' sprites)
+		draw_sprites(0x00); //draw sprites with priority == 0 ('in front' sprites)
 
-	assert(triangle_strip.size() == TristripSize && "Triangle strip size was estimated exactly.");
+		assert(triangle_strip.size() == TristripSize && "Triangle strip size was estimated exactly.");
+	}
 
 	//-------------------------------------------------
 	//Upload at to GPU using PPUDataStream:
 
 	{ //upload palette texture:
-		static_assert(sizeof(palette_table) == 4 * 4 * decltype(palette_table)().size(), "palette table is packed");
+		PROFILE_SCOPE("upload palettes");
+		GL_PROFILE_SCOPE("upload palettes");
+		static_assert(sizeof(palette_table) == 4 * 4 * PaletteCount, "palette table is packed");
 		glBindTexture(GL_TEXTURE_2D, data_stream->palette_tex);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 4, GLsizei(palette_table.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, palette_table.data());
 		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 
-	{ //build + upload tile table texture:
-		//interpret tiles and build a 128 x 128 index texture:
-		static std::array< uint8_t, 128 * 128 > data;
+	//build + upload tile table texture (only if tiles have changed since the last upload):
+	if (!data_stream->tile_tex_valid
+	 || data_stream->tile_tex_contents.size() != tile_table.size()
+	 || std::memcmp(data_stream->tile_tex_contents.data(), tile_table.data(), sizeof(tile_table)) != 0) {
+		PROFILE_SCOPE("build + upload tiles");
+		//interpret tiles and build TileLayers 128 x 128 index images:
+		static TileIndices data;
 		for (uint32_t i = 0; i < tile_table.size(); ++i) {
 			Tile const &tile = tile_table[i];
 
 			//location of tile in the texture:
 			uint32_t ox = (i % 16) * 8;
-			uint32_t oy = (i / 16) * 8;
+			uint32_t oy = ((i / 16) % 16) * 8;
+			uint32_t oz = (i / 256) * 128 * 128;
 
 			//copy tile indices into texture:
 			for (uint32_t y = 0; y < 8; ++y) {
 				for (uint32_t x = 0; x < 8; ++x) {
-					data[ox+x + 128 * (oy+y)] =
+					data[oz + ox+x + 128 * (oy+y)] =
 						  ((tile.bit0[y] >> x) & 1)
 						| ((tile.bit1[y] >> x) & 1) << 1;
 				}
 			}
 		}
 
-		glBindTexture(GL_TEXTURE_2D, data_stream->tile_tex);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, 128, 128, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, data.data());
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GL_PROFILE_SCOPE("upload tiles");
+		upload_tile_indices(data);
 	}
 
 	{ //upload vertex data:
+		PROFILE_SCOPE("upload vertices");
+		GL_PROFILE_SCOPE("upload vertices");
 		glBindBuffer(GL_ARRAY_BUFFER, data_stream->vertex_buffer);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(decltype(triangle_strip[0])) * triangle_strip.size(), triangle_strip.data(), GL_STREAM_DRAW);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -267,16 +347,20 @@ void PPU466::draw(glm::uvec2 const &drawable_size) const {
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, data_stream->palette_tex);
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, data_stream->tile_tex);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, data_stream->tile_tex);
 
 	//now that the pipeline is configured, trigger drawing of triangle strip:
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, GLsizei(triangle_strip.size()));
+	{
+		PROFILE_SCOPE("draw call");
+		GL_PROFILE_SCOPE("draw call");
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, GLsizei(triangle_strip.size()));
+	}
 
 	//return state to default:
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, 0);
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
 	glBindVertexArray(0);
 	glUseProgram(0);
@@ -290,6 +374,27 @@ void PPU466::draw(glm::uvec2 const &drawable_size) const {
 }
 
 
+template< uint32_t T, uint32_t P, uint32_t S, uint32_t W, uint32_t H >
+void PPU< T, P, S, W, H >::upload_tile_indices(TileIndices const &indices) const {
+	glBindTexture(GL_TEXTURE_2D_ARRAY, data_stream->tile_tex);
+	if (data_stream->tile_tex_layers == TileLayers) {
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, 128, 128, TileLayers, GL_RED_INTEGER, GL_UNSIGNED_BYTE, indices.data());
+	} else {
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8UI, 128, 128, TileLayers, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, indices.data());
+		data_stream->tile_tex_layers = TileLayers;
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	data_stream->tile_tex_contents.assign(tile_table.begin(), tile_table.end());
+	data_stream->tile_tex_valid = true;
+
+	GL_ERRORS();
+}
+
+template struct PPU< 256, 8, 64 >;
+template struct PPU< 1024, 16, 256 >;
+template struct PPU< 4096, 64, 1024 >;
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 PPUTileProgram::PPUTileProgram() {
@@ -298,25 +403,28 @@ PPUTileProgram::PPUTileProgram() {
 		"#version 330\n"
 		"uniform mat4 OBJECT_TO_CLIP;\n"
 		"in vec4 Position;\n"
-		"in ivec2 TileCoord;\n"
+		"in ivec3 TileCoord;\n"
 		"in int Palette;\n"
 		"out vec2 tileCoord;\n"
+		"flat out int layer;\n"
 		"flat out int palette;\n"
 		"void main() {\n"
 		"	gl_Position = OBJECT_TO_CLIP * Position;\n"
-		"	tileCoord = TileCoord;\n"
+		"	tileCoord = TileCoord.xy;\n"
+		"	layer = TileCoord.z;\n"
 		"	palette = Palette;\n"
 		"}\n"
 	,
 		//fragment shader:
 		"#version 330\n"
-		"uniform usampler2D TILE_TABLE;\n"
+		"uniform usampler2DArray TILE_TABLE;\n"
 		"uniform sampler2D PALETTE_TABLE;\n"
 		"in vec2 tileCoord;\n"
+		"flat in int layer;\n"
 		"flat in int palette;\n" //"flat" means "uses the value of the provoking [by default, last] vertex in the primitive"
 		"out vec4 fragColor;\n"
 		"void main() {\n"
-		"	uint index = texelFetch(TILE_TABLE, ivec2(tileCoord), 0).r;\n"
+		"	uint index = texelFetch(TILE_TABLE, ivec3(ivec2(tileCoord), layer), 0).r;\n"
 		"	fragColor = texelFetch(PALETTE_TABLE, ivec2(index, palette), 0);\n"
 		//"	fragColor = vec4(float(index)/4.0,float(palette)/8,1,1);\n"
 		//"	fragColor = texelFetch(TILE_TABLE, ivec2(int(gl_FragCoord.x) % textureSize(TILE_TABLE,0).x, int(gl_FragCoord.y) % textureSize(TILE_TABLE,0).y), 0);\n"
@@ -326,18 +434,18 @@ PPUTileProgram::PPUTileProgram() {
 
 	//look up the locations of vertex attributes:
 	Position_vec2 = glGetAttribLocation(program, "Position");
-	TileCoord_ivec2 = glGetAttribLocation(program, "TileCoord");
+	TileCoord_ivec3 = glGetAttribLocation(program, "TileCoord");
 	Palette_int = glGetAttribLocation(program, "Palette");
 
 	//look up the locations of uniforms:
 	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
 
-	GLuint TILE_TABLE_usampler2D = glGetUniformLocation(program, "TILE_TABLE");
+	GLuint TILE_TABLE_usampler2DArray = glGetUniformLocation(program, "TILE_TABLE");
 	GLuint PALETTE_TABLE_sampler2D = glGetUniformLocation(program, "PALETTE_TABLE");
 
 	//bind texture units indices to samplers:
 	glUseProgram(program);
-	glUniform1i(TILE_TABLE_usampler2D, 0);
+	glUniform1i(TILE_TABLE_usampler2DArray, 0);
 	glUniform1i(PALETTE_TABLE_sampler2D, 1);
 	glUseProgram(0);
 
@@ -378,13 +486,13 @@ PPUDataStream::PPUDataStream() {
 
 	//the "I" variant binds to an integer attribute:
 	glVertexAttribIPointer(
-		tile_program->TileCoord_ivec2, //attribute
-		2, //size
+		tile_program->TileCoord_ivec3, //attribute
+		3, //size
 		GL_INT, //type
 		sizeof(Vertex), //stride
 		(GLbyte *)0 + offsetof(Vertex, TileCoord) //offset
 	);
-	glEnableVertexAttribArray(tile_program->TileCoord_ivec2);
+	glEnableVertexAttribArray(tile_program->TileCoord_ivec3);
 
 	//I could have stored the Palette as another entry in the TileCoord attribute stream
 	glVertexAttribIPointer(
@@ -402,17 +510,17 @@ PPUDataStream::PPUDataStream() {
 
 
 	glGenTextures(1, &tile_tex);
-	glBindTexture(GL_TEXTURE_2D, tile_tex);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, tile_tex);
 	//passing 'nullptr' to TexImage says "allocate memory but don't store anything there":
-	// (textures will be uploaded later)
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, 128, 128, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+	// (textures will be uploaded later; one layer to start with, which is all PPU466 needs)
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8UI, 128, 128, tile_tex_layers, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, nullptr);
 	//make the texture have sharp pixels when magnified:
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	//when access past the edge, clamp to the edge:
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
 
 	glGenTextures(1, &palette_tex);
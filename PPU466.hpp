@@ -3,13 +3,67 @@
 /*
  * PPU466 -- a very limited graphics system [loosely] based on the NES's PPU.
  *
+ * The capacities (tiles, palettes, sprites, background size) are template parameters of PPU<>;
+ * PPU466 is the classic 256 tiles / 8 palettes / 64 sprites / 64x60 background,
+ * and PPUExtended is a roomier mode (4096 tiles, 64 palettes, 1024 sprites) for games that outgrow it.
+ * Every mode draws with the same shader in a single draw call:
+ *  the tile table is a texture array with 256 tiles per layer,
+ *  and only the background tiles that overlap the screen are drawn, so background size doesn't affect draw cost.
+ *
+ * The implementation lives in PPU466.cpp, which instantiates the modes declared at the bottom of this file.
+ *
  */
 
 #include <glm/glm.hpp>
 #include <array>
+#include <type_traits>
+#include <cstdint>
+
+//Tile:
+// The PPU uses 8x8 2-bit indexed-color tiles:
+// each tile is stored as two 8x8 "bit plane" images
+//   each bit-plane image is stored in rows from bottom-to-top
+//   each bit in a row corresponds to a pixel in increasing order:
+//      [ b0 b1 b2 b3 b4 b5 b6 b7 ]
+//
+// For example, to read the color index at pixel (2,7):
+//  bit0_at_2_7 = (tile.bit0[7] >> 2) & 1;
+//  bit1_at_2_7 = (tile.bit1[7] >> 2) & 1;
+//  color_index_at_2_7 = (bit1_at_2_7 << 1) | bit0_at_2_7;
+// (shared by all PPU modes, so tiles can be copied between them)
+struct PPUTile {
+	std::array< uint8_t, 8 > bit0; //<-- controls bit 0 of the color index
+	std::array< uint8_t, 8 > bit1; //<-- controls bit 1 of the color index
+};
+static_assert(sizeof(PPUTile) == 16, "Tile is packed");
 
-struct PPU466 {
-	PPU466();
+//Palette:
+// The PPU uses 2-bit indexed color;
+// thus, a color palette has four entries.
+typedef std::array< glm::u8vec4, 4 > PPUPalette;
+
+//number of bits needed to store indices [0, count):
+constexpr uint32_t ppu_index_bits(uint32_t count) {
+	return (count <= 1 ? 0 : 1 + ppu_index_bits((count + 1) / 2));
+}
+
+template< uint32_t Tiles_, uint32_t Palettes_, uint32_t Sprites_, uint32_t BackgroundWidth_ = 64, uint32_t BackgroundHeight_ = 60 >
+struct PPU {
+	PPU();
+
+	//capacities of this mode:
+	enum : uint32_t {
+		TileCount = Tiles_,
+		PaletteCount = Palettes_,
+		SpriteCount = Sprites_,
+		TileBits = ppu_index_bits(Tiles_), //bits in a tile index
+		PaletteBits = ppu_index_bits(Palettes_), //bits in a palette index
+		TileLayers = Tiles_ / 256, //tiles are drawn from 128x128 images of 256 tiles each
+	};
+	static_assert(Tiles_ >= 256 && (Tiles_ & (Tiles_ - 1)) == 0, "tile count is a power of two, at least 256");
+	static_assert(Tiles_ <= 65536, "tile indices fit in 16 bits");
+	static_assert(Palettes_ >= 1 && (Palettes_ & (Palettes_ - 1)) == 0, "palette count is a power of two");
+	static_assert(PaletteBits <= 7, "palette index fits below the sprite priority bit");
 
 	//--------------------------------------------------------------
 	//Call these functions to draw with the PPU:
@@ -18,6 +72,10 @@ struct PPU466 {
 	// pass the size of the current framebuffer in pixels so it knows how to scale itself
 	void draw(glm::uvec2 const &drawable_size) const;
 
+	//while tables aren't ready yet, draw a loading bar instead:
+	// (clears to background_color and fills 'progress' [0,1] of a bar in 'bar_color'; uses no tiles or palettes)
+	void draw_loading(glm::uvec2 const &drawable_size, float progress, glm::u8vec3 bar_color = glm::u8vec3(0xff, 0xff, 0xff)) const;
+
 	//--------------------------------------------------------------
 	//Set the values below to control the PPU's drawing:
 
@@ -33,49 +91,49 @@ struct PPU466 {
 	glm::u8vec3 background_color = glm::u8vec3(0x00, 0x00, 0x00);
 
 	//Palette:
-	// The PPU uses 2-bit indexed color;
-	// thus, a color palette has four entries.
-	typedef std::array< glm::u8vec4, 4 > Palette;
+	// (see PPUPalette above)
+	typedef PPUPalette Palette;
 	// Each color in a Palette can be any RGBA color.
 	// For a "true NES" experience, you should set:
 	//   color 0 to fully transparent (a = 0)
 	//   and color 1-3 to fully opaque (a = 0xff)
 
 	//Palette Table:
-	// The PPU stores 8 palettes for use when drawing tiles:
-	std::array< Palette, 8 > palette_table;
+	// The PPU stores PaletteCount (8 in PPU466) palettes for use when drawing tiles:
+	std::array< Palette, PaletteCount > palette_table;
 
 	//Tile:
-	// The PPU uses 8x8 2-bit indexed-color tiles:
-	// each tile is stored as two 8x8 "bit plane" images
-	//   each bit-plane image is stored in rows from bottom-to-top
-	//   each bit in a row corresponds to a pixel in increasing order:
-	//      [ b0 b1 b2 b3 b4 b5 b6 b7 ]
-	//
-	// For example, to read the color index at pixel (2,7):
-	//  bit0_at_2_7 = (tile.bit0[7] >> 2) & 1;
-	//  bit1_at_2_7 = (tile.bit1[7] >> 2) & 1;
-	//  color_index_at_2_7 = (bit1_at_2_7 << 1) | bit0_at_2_7;
-	struct Tile {
-		std::array< uint8_t, 8 > bit0; //<-- controls bit 0 of the color index
-		std::array< uint8_t, 8 > bit1; //<-- controls bit 1 of the color index
-	};
-	static_assert(sizeof(Tile) == 16, "Tile is packed");
+	// (see PPUTile above)
+	typedef PPUTile Tile;
 
 	//Tile Table:
-	// The PPU has a 256-tile 'pattern memory' in which tiles are stored:
-	//  this is often thought of as a 16x16 grid of tiles.
-	std::array< Tile, 16 * 16 > tile_table;
+	// The PPU has a TileCount-tile (256 in PPU466) 'pattern memory' in which tiles are stored:
+	//  this is often thought of as a 16x16 grid of tiles (or, in bigger modes, a stack of such grids).
+	std::array< Tile, TileCount > tile_table;
+
+	//Tile Index:
+	// the type used to refer to a tile in the tile table (uint8_t for 256 tiles, uint16_t for more):
+	typedef typename std::conditional< (TileCount <= 256), uint8_t, uint16_t >::type TileIndex;
+
+	//Tile Indices:
+	// To draw, the tile table is expanded into TileLayers 128x128 images of color indices
+	//  (tile i is in image i / 256, with its lower-left corner at pixel ((i % 16) * 8, ((i / 16) % 16) * 8)).
+	// draw() re-builds and re-uploads these images only when tile_table has changed.
+	typedef std::array< uint8_t, 128 * 128 * TileLayers > TileIndices;
+	//
+	// If you already have the expanded image (e.g., the "tidx" chunk written by process_assets),
+	//  set tile_table first and then hand over the image to skip the expansion:
+	void upload_tile_indices(TileIndices const &indices) const;
 
 	//Background Layer:
-	// The PPU's background layer is made of 64x60 tiles (512 x 480 pixels).
+	// The PPU's background layer is made of 64x60 tiles (512 x 480 pixels) in PPU466.
 	// This is twice the size of the screen, to support scrolling.
 	enum : uint32_t {
-		BackgroundWidth = 64,
-		BackgroundHeight = 60
+		BackgroundWidth = BackgroundWidth_,
+		BackgroundHeight = BackgroundHeight_
 	};
 
-	// The background is stored as a row-major grid of 16-bit values:
+	// The background is stored as a row-major grid of 16-bit values (32-bit in modes that need more bits):
 	//  the origin of the grid (tile (0,0)) is the bottom left of the grid
 	//  each value in the grid gives:
 	//    - bits 0-7: tile table index
@@ -87,7 +145,13 @@ struct PPU466 {
 	//            ^        ^        ^-- tile index
 	//            |        '----------- palette index
 	//            '-------------------- unused (set to zero)
-	std::array< uint16_t, BackgroundWidth * BackgroundHeight > background;
+	//
+	//  (in general: the low TileBits bits are the tile index, the next PaletteBits bits are the palette index)
+	enum : uint32_t {
+		PaletteShift = TileBits
+	};
+	typedef typename std::conditional< (TileBits + PaletteBits <= 16), uint16_t, uint32_t >::type BackgroundEntry;
+	std::array< BackgroundEntry, BackgroundWidth * BackgroundHeight > background;
 
 	//Background Position:
 	// The background's lower-left pixel can positioned anywhere
@@ -111,7 +175,7 @@ struct PPU466 {
 	//   bits:  7 6 5 4 3 2 1 0
 	//         |-|-------|-----|
 	//          ^    ^      ^
-	//          |    |      '---- palette index (bits 0-2)
+	//          |    |      '---- palette index (bits 0-2; in general, the low PaletteBits bits)
 	//          |    '----------- unused (set to zero)
 	//          '---------------- priority bit (bit 7)
 	//
@@ -122,18 +186,43 @@ struct PPU466 {
 	struct Sprite {
 		uint8_t x = 0; //x position. 0 is the left edge of the screen.
 		uint8_t y = 240; //y position. 0 is the bottom edge of the screen. >= 240 is off-screen
-		uint8_t index = 0; //index into tile table
+		TileIndex index = 0; //index into tile table
 		uint8_t attributes = 0; //tile attribute bits
 	};
-	static_assert(sizeof(Sprite) == 4, "Sprite is a 32-bit value.");
+	static_assert(TileCount > 256 || sizeof(Sprite) == 4, "Sprite is a 32-bit value.");
 	//
 	// The observant among you will notice that you can't draw a sprite moving off the left
 	//  or bottom edges of the screen. Yep! This is [similar to] a limitation of the NES PPU!
 
 
 	//Sprites:
-	// The PPU always draws exactly 64 sprites:
+	// The PPU always draws exactly SpriteCount (64 in PPU466) sprites:
 	//  any sprites you don't want to use should be moved off the screen (y >= 240)
-	std::array< Sprite, 64 > sprites;
+	std::array< Sprite, SpriteCount > sprites;
+
+	//--------------------------------------------------------------
+	//Save states:
+	// all of the tables above, as one fixed-size block (no pointers, so saving + restoring never allocate):
+	struct State {
+		glm::u8vec3 background_color;
+		std::array< Palette, PaletteCount > palette_table;
+		std::array< Tile, TileCount > tile_table;
+		std::array< BackgroundEntry, BackgroundWidth * BackgroundHeight > background;
+		glm::ivec2 background_position;
+		std::array< Sprite, SpriteCount > sprites;
+	};
+	void save_state(State *state) const;
+	void load_state(State const &state); //(changed tiles are re-uploaded by the next draw())
 
 };
+
+//The classic mode:
+typedef PPU< 256, 8, 64 > PPU466;
+
+//A roomier mode:
+typedef PPU< 4096, 64, 1024 > PPUExtended;
+
+//(these -- and the in-between mode used by utils/bench_ppu -- are instantiated in PPU466.cpp)
+extern template struct PPU< 256, 8, 64 >;
+extern template struct PPU< 1024, 16, 256 >;
+extern template struct PPU< 4096, 64, 1024 >;
@@ -4,49 +4,33 @@
 #include "gl_errors.hpp"
 
 #include "data_path.hpp"
-#include "read_write_chunk.hpp"
+#include "profile.hpp"
+#include "FrameStats.hpp"
 
 //for glm::value_ptr() :
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
 #include <random>
-#include <fstream>
+#include <cstring>
+#include <iostream>
 
-PlayMode::PlayMode() {
+constexpr size_t PlayMode::RewindBytes;
+constexpr uint32_t PlayMode::RewindFrames;
 
-	std::vector<PPU466::Palette> palette_table;
-	std::vector<PPU466::Tile> tile_table;
-	std::vector<Level> levels;
+PlayMode::PlayMode() : history(sizeof(Simulation::State), RewindBytes, RewindFrames), rewind_state(new Simulation::State()) {
 
-	//read chunks from binary
-	std::ifstream in(data_path("../tilebin"), std::ios::binary);
-	read_chunk(in, "tile", &tile_table);
-	read_chunk(in, "pale", &palette_table);
-	read_chunk(in, "tmap", &tile_to_palette_map);
-	read_chunk(in, "lvls", &levels);
+	//(rewind keyframes only need to store what differs from a fresh state)
+	history.set_base(rewind_state.get());
 
-	assert(tile_table.size() <= 256);
-	assert(palette_table.size() <= 8);
+	//read chunks from binary in the background (see take_loaded()):
+	load_start = std::chrono::steady_clock::now();
+	loader.reset(new TileBinLoader(data_path("../tilebin")));
 
 	//a light blue
 	ppu.background_color = glm::u8vec3(0xbc, 0xe7, 0xfd);
-	
-	//reset tables
-	for (uint32_t i = 0; i < 16 * 16; i++) {
-		ppu.tile_table[i].bit0.fill(0);
-		ppu.tile_table[i].bit1.fill(0);
-	}
-	for (uint32_t i = 0; i < 8; i++) {
-		ppu.palette_table[i].fill(glm::u8vec4(0x00, 0x00, 0x00, 0x00));
-	}
-
-	//read tables
-	for (uint32_t i = 0; i < tile_table.size(); ++i) {
-		ppu.tile_table[i] = tile_table[i];
-	}
-	for (uint32_t i = 0; i < palette_table.size(); ++i) {
-		ppu.palette_table[i] = palette_table[i];
-	}
 
 	//reset bg
 	for (uint32_t y = 0; y < PPU466::BackgroundHeight; ++y) {
@@ -55,69 +39,256 @@ PlayMode::PlayMode() {
 		}
 	}
 
-	//init level
+	//level 0 is started as soon as it arrives:
 	level_index = 0;
-	level = levels[level_index];
-	player_at = level.starting_pos;
-	for (uint32_t x = 0; x < 16; ++x) {
-		for (uint32_t y = 0; y < 15; ++y) {
-			if (level.boxes[x][y]) {
-				box_positions.push_back(glm::vec2(x * 16, y * 16));
-				box_velocities.push_back(glm::vec2(0.0f));
+}
+
+void PlayMode::take_loaded() {
+	TileBin bin;
+	if (!loader->take(&bin)) return;
+
+	if (!bin.tile_indices.empty()) {
+		apply_tables(bin);
+	}
+	if (bin.levels) levels = bin.levels;
+
+	if (!playing && !tile_to_palette_map.empty() && levels) {
+		//(asked for a level that doesn't exist? fall back to the first)
+		if (level_index < 0 || uint32_t(level_index) >= levels->size()) {
+			std::cerr << "WARNING: there is no level " << level_index << " (only " << levels->size() << "); starting level 0 instead." << std::endl;
+			level_index = 0;
+		}
+		go_to_level(level_index);
+		playing = true;
+		if (recording) recording->header.level_index = level_index; //(replays start where the recording started)
+		std::cout << "Started level " << level_index << " after " << std::chrono::duration< float, std::milli >(std::chrono::steady_clock::now() - load_start).count() << " ms." << std::endl;
+	}
+
+	if (loader->finished()) {
+		loader.reset();
+		std::cout << "Loaded tilebin: " << levels->size() << " levels in " << std::chrono::duration< float, std::milli >(std::chrono::steady_clock::now() - load_start).count() << " ms." << std::endl;
+	}
+}
+
+void PlayMode::apply_tilebin(TileBin const &bin) {
+	glm::uvec2 changed = apply_tables(bin);
+	uint32_t tiles_changed = changed.x;
+	uint32_t palettes_changed = changed.y;
+
+	//(compares stored records, so nothing but the current level gets decoded)
+	uint32_t levels_changed = 0;
+	for (uint32_t i = 0; i < bin.levels->size(); ++i) {
+		if (!levels || !levels->same_level(i, *bin.levels)) levels_changed += 1;
+	}
+	levels = bin.levels;
+
+	//if the level being played changed, swap in the new layout; objects are only reset if their starting spots moved:
+	if (level_index < 0 || uint32_t(level_index) >= levels->size()) level_index = 0;
+	if (!playing) {
+		go_to_level(level_index);
+		playing = true;
+		if (recording) recording->header.level_index = level_index;
+	} else {
+		std::shared_ptr< Level const > updated = levels->get(level_index);
+		if (sim.level != *updated) {
+			//(the level isn't part of save states, so 'R' and rewinding keep the new layout)
+			bool restart = sim.level.width != updated->width || sim.level.height != updated->height || sim.level.starting_pos != updated->starting_pos;
+			for (uint32_t i = 0; i < updated->cells.size() && !restart; ++i) {
+				restart = (sim.level.cells[i] == Level::Box) != (updated->cells[i] == Level::Box);
 			}
+			sim.level = *updated;
+			if (restart) start_level();
 		}
+		levels->prefetch((level_index + 1) % levels->size());
+	}
+	streamed = false;
+
+	std::cout << "Loaded tilebin: " << tiles_changed << " tiles, " << palettes_changed << " palettes, and " << levels_changed << " levels changed." << std::endl;
+}
+
+glm::uvec2 PlayMode::apply_tables(TileBin const &bin) {
+	//only entries that actually differ are replaced (entries past the end of the tilebin's tables are cleared):
+	PPU466::Tile blank_tile;
+	blank_tile.bit0.fill(0);
+	blank_tile.bit1.fill(0);
+	uint32_t tiles_changed = 0;
+	for (uint32_t i = 0; i < ppu.tile_table.size(); ++i) {
+		PPU466::Tile const &tile = (i < bin.tile_table.size() ? bin.tile_table[i] : blank_tile);
+		if (std::memcmp(&ppu.tile_table[i], &tile, sizeof(tile)) != 0) {
+			ppu.tile_table[i] = tile;
+			tiles_changed += 1;
+		}
+	}
+	//tiles come pre-expanded, so upload them here instead of having the PPU unpack them:
+	if (tiles_changed) {
+		ppu.upload_tile_indices(bin.tile_indices[0]);
 	}
+
+	PPU466::Palette blank_palette;
+	blank_palette.fill(glm::u8vec4(0x00, 0x00, 0x00, 0x00));
+	uint32_t palettes_changed = 0;
+	for (uint32_t i = 0; i < ppu.palette_table.size(); ++i) {
+		PPU466::Palette const &palette = (i < bin.palette_table.size() ? bin.palette_table[i] : blank_palette);
+		if (ppu.palette_table[i] != palette) {
+			ppu.palette_table[i] = palette;
+			palettes_changed += 1;
+		}
+	}
+
+	tile_to_palette_map = bin.tile_to_palette_map;
+	tile_palettes_used = uint32_t(bin.palette_table.size());
+	streamed = false; //(background entries include palette indices)
+	sprite_batch.invalidate(); //(...as do sprites)
+
+	sim.animations = bin.animations;
+
+	return glm::uvec2(tiles_changed, palettes_changed);
+}
+
+void PlayMode::go_to_level(int32_t index) {
+	assert(levels && index >= 0 && uint32_t(index) < levels->size());
+	level_index = index;
+	sim.level = *levels->get(index); //(usually already decoded by the prefetch below)
+	start_level();
+	history.clear(); //(rewinding only restores Simulation::State, which doesn't include the level)
+
+	//the next level is the likely next stop, so start decoding it now:
+	levels->prefetch((index + 1) % levels->size());
+}
+
+void PlayMode::start_level() {
+	sim.reset_level();
+	streamed = false;
+	save_snapshot(&level_start);
+}
+
+void PlayMode::restart_level() {
+	//(the tick count carries on, so recordings stay in step; held keys stay held since input isn't part of the state)
+	uint32_t tick = sim.tick;
+	sim.load_state(level_start.sim);
+	sim.tick = tick;
+}
+
+void PlayMode::save_snapshot(Snapshot *snapshot) const {
+	assert(snapshot);
+	sim.save_state(&snapshot->sim);
+	snapshot->level_index = level_index;
+	ppu.save_state(&snapshot->ppu);
+}
+
+void PlayMode::load_snapshot(Snapshot const &snapshot) {
+	sim.load_state(snapshot.sim);
+	if (snapshot.level_index != level_index && levels) {
+		sim.level = *levels->get(snapshot.level_index);
+	}
+	level_index = snapshot.level_index;
+	ppu.load_state(snapshot.ppu);
+	streamed = false; //(the restored background was streamed for some other camera position)
+	sprite_batch.invalidate(); //(...and the restored sprites are whatever was drawn then)
+}
+
+void PlayMode::print_rewind_stats() const {
+	RewindBuffer::Stats const &stats = history.stats;
+	std::cout << "Rewind: " << history.frames() << " ticks (" << history.frames() * Simulation::Tick << " s) in "
+		<< history.bytes_used() / 1024 << " of " << history.arena_size() / 1024 << " kB; "
+		<< (stats.deltas ? stats.delta_bytes / stats.deltas : 0) << " bytes/frame for deltas, "
+		<< (stats.keyframes ? stats.keyframe_bytes / stats.keyframes : 0) << " bytes/keyframe, "
+		<< (stats.deltas + stats.keyframes ? (stats.delta_bytes + stats.keyframe_bytes) / (stats.deltas + stats.keyframes) : 0) << " bytes/frame overall"
+		<< " (" << sizeof(Simulation::State) << " bytes uncompressed)." << std::endl;
+}
+
+void PlayMode::record_replay(std::string const &filename) {
+	recording.reset(new InputReplay());
+	recording_filename = filename;
+}
+
+void PlayMode::watch_assets() {
+	asset_watcher.reset(new AssetWatcher(
+		{ data_path("../tiles"), data_path("../levels") },
+		"\"" + data_path("../utils/process_assets") + "\"",
+		data_path("../tilebin")
+	));
+}
+
+void PlayMode::play_replay(std::string const &filename) {
+	replay.reset(new InputReplay(filename));
+	level_index = replay->header.level_index;
 }
 
 PlayMode::~PlayMode() {
+	if (recording) {
+		recording->header.ticks = sim.tick;
+		recording->header.final_state = sim.state_checksum();
+		try {
+			recording->save(recording_filename);
+			std::cout << "Saved " << recording->events.size() << " inputs over " << sim.tick << " ticks to '" << recording_filename << "'." << std::endl;
+		} catch (std::exception &e) {
+			std::cerr << "Failed to save replay: " << e.what() << std::endl;
+		}
+	}
 }
 
 bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size) {
+	if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F3) {
+		show_frame_stats = !show_frame_stats;
+		return true;
+	} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F4) {
+		print_rewind_stats();
+		return true;
+	}
+
+	//while replaying, the game only sees recorded input:
+	if (replay) return false;
 
+	if (!handle_input(evt)) return false;
+	if (recording) recording->record(sim.tick, evt);
+	return true;
+}
+
+bool PlayMode::handle_input(SDL_Event const &evt) {
 	if (evt.type == SDL_KEYDOWN) {
 		if (evt.key.keysym.sym == SDLK_LEFT) {
-			left.downs += 1;
-			left.pressed = true;
+			sim.left.downs += 1;
+			sim.left.pressed = true;
 			return true;
 		} else if (evt.key.keysym.sym == SDLK_RIGHT) {
-			right.downs += 1;
-			right.pressed = true;
+			sim.right.downs += 1;
+			sim.right.pressed = true;
 			return true;
 		} else if (evt.key.keysym.sym == SDLK_UP) {
-			up.downs += 1;
-			up.pressed = true;
+			sim.up.downs += 1;
+			sim.up.pressed = true;
 			return true;
 		} else if (evt.key.keysym.sym == SDLK_DOWN) {
-			down.downs += 1;
-			down.pressed = true;
+			sim.down.downs += 1;
+			sim.down.pressed = true;
 			return true;
 		}
 		else if (evt.key.keysym.sym == SDLK_r) {
-			player_at = level.starting_pos;
-			box_positions.clear();
-			box_velocities.clear();
-			for (uint32_t x = 0; x < 16; ++x) {
-				for (uint32_t y = 0; y < 15; ++y) {
-					if (level.boxes[x][y]) {
-						box_positions.push_back(glm::vec2(x * 16, y * 16));
-						box_velocities.push_back(glm::vec2(0.0f));
-					}
-				}
-			}
+			if (playing) restart_level();
+			return true;
+		} else if (evt.key.keysym.sym == SDLK_n) {
+			if (playing) go_to_level((level_index + 1) % levels->size());
+			return true;
+		} else if (evt.key.keysym.sym == SDLK_BACKSPACE) {
+			rewinding = true;
 			return true;
 		}
 	} else if (evt.type == SDL_KEYUP) {
 		if (evt.key.keysym.sym == SDLK_LEFT) {
-			left.pressed = false;
+			sim.left.pressed = false;
 			return true;
 		} else if (evt.key.keysym.sym == SDLK_RIGHT) {
-			right.pressed = false;
+			sim.right.pressed = false;
 			return true;
 		} else if (evt.key.keysym.sym == SDLK_UP) {
-			up.pressed = false;
+			sim.up.pressed = false;
 			return true;
 		} else if (evt.key.keysym.sym == SDLK_DOWN) {
-			down.pressed = false;
+			sim.down.pressed = false;
+			return true;
+		} else if (evt.key.keysym.sym == SDLK_BACKSPACE) {
+			rewinding = false;
 			return true;
 		}
 	}
@@ -126,154 +297,160 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 }
 
 void PlayMode::update(float elapsed) {
+	PROFILE_SCOPE("PlayMode::update");
 
-	animate_timer += elapsed;
-	if (animate_timer > 0.5f) {
-		animate = !animate;
-		animate_timer = 0.0f;
+	//pick up assets as the startup load finishes them:
+	if (loader) {
+		take_loaded();
 	}
 
-	constexpr float PlayerSpeed = 30.0f;
-	if (left.pressed) player_at.x -= PlayerSpeed * elapsed;
-	if (right.pressed) player_at.x += PlayerSpeed * elapsed;
-	if (down.pressed) player_at.y -= PlayerSpeed * elapsed;
-	if (up.pressed) player_at.y += PlayerSpeed * elapsed;
-	//
-	//if (up.pressed && grounded) player_velocity.y += 10;
-	//player_at += player_velocity * elapsed;
-
-	//reset button press counters:
-	left.downs = 0;
-	right.downs = 0;
-	up.downs = 0;
-	down.downs = 0;
-
-	//I would put the code here for character and scene collision and whatnot but I spent too much time trying to get the PPU to display my sprites and also other life things
-	//but essentially I would check if object[character_x][character_y] +- some buffer, do something like make character grounded.
-	/*
-	if (!grounded) {
-		player_velocity.y += gravity;
+	//pick up any assets that were rebuilt while running:
+	if (std::unique_ptr< TileBin > bin = (asset_watcher ? asset_watcher->take() : nullptr)) {
+		loader.reset(); //(the rebuilt tilebin replaces whatever is still loading)
+		apply_tilebin(*bin);
 	}
-	*/
-}
 
-void PlayMode::draw(glm::uvec2 const &drawable_size) {
-	//fill
-	for (uint32_t y = 0; y < PPU466::BackgroundHeight; ++y) {
-		for (uint32_t x = 0; x < PPU466::BackgroundWidth; ++x) {
-			ppu.background[x + PPU466::BackgroundWidth * y] = (7 << 8) | 255;
-		}
-	}
+	if (!playing) return;
 
-	int hazardCount = 0;
-	for (uint32_t x = 0; x < 16; ++x) {
-		for (uint32_t y = 0; y < 15; ++y) {
-			if (level.topblocks[x][y]) {
-				for (uint8_t xCount = 0; xCount < 2; ++xCount) {
-					for (uint8_t yCount = 0; yCount < 2; ++yCount) {
-						uint8_t offset = xCount + yCount * 2;
-						int xCoord = x * 16 + (xCount * 8);
-						int yCoord = y * 16 + (yCount * 8);
-						uint8_t what = offset + 8;
-						ppu.background[xCoord + PPU466::BackgroundWidth * yCoord] = (tile_to_palette_map[8 + offset] << 8) | what;
-					}
-				}
-			}
-			else if (level.blocks[x][y]) {
-				//std::cout << "a block exists at " << x << " and " << y << "\n";
-				for (uint8_t xCount = 0; xCount < 2; ++xCount) {
-					for (uint8_t yCount = 0; yCount < 2; ++yCount) {
-						uint8_t offset = xCount + yCount * 2;
-						int xCoord = x * 16 + (xCount * 8);
-						int yCoord = y * 16 + (yCount * 8);
-						uint8_t what = offset + 12;
-						ppu.background[xCoord + PPU466::BackgroundWidth * yCoord] = (tile_to_palette_map[12 + offset] << 8) | what;
-					}
-				}
-			}
-			else if (level.ladders[x][y]) {
-				for (uint8_t xCount = 0; xCount < 2; ++xCount) {
-					for (uint8_t yCount = 0; yCount < 2; ++yCount) {
-						uint8_t offset = xCount + yCount * 2;
-						int xCoord = x * 16 + (xCount * 8);
-						int yCoord = y * 16 + (yCount * 8);
-						uint8_t what = offset + 28;
-						//for some reason this doesn't work and I suspect it's also why the blocks are drawing vertically
-						//ppu.background[xCoord + PPU466::BackgroundWidth * yCoord] = (tile_to_palette_map[28 + offset] << 8) | what;
-					}
-				}
-			}
-			else if (level.hazards[x][y]) {
-				for (uint8_t xCount = 0; xCount < 2; ++xCount) {
-					for (uint8_t yCount = 0; yCount < 2; ++yCount) {
-						uint8_t offset = xCount + yCount * 2;
-						int xCoord = x * 16 + (xCount * 8);
-						int yCoord = y * 16 + (yCount * 8);
-						uint8_t what = offset + 28 + ((hazardCount%3) * 4);
-						ppu.background[xCoord + PPU466::BackgroundWidth * yCoord] = (tile_to_palette_map[32 + offset + ((hazardCount % 3) * 4)] << 8) | what;
-					}
-				}
-				hazardCount++;
+	//the simulation runs in fixed steps, so the same input at the same ticks always gives the same result:
+	tick_accumulator += elapsed;
+	while (tick_accumulator >= Simulation::Tick && !replay_finished()) {
+		tick_accumulator -= Simulation::Tick;
+		if (replay) {
+			if (sim.tick == 0) replay_start = std::chrono::steady_clock::now();
+			for (SDL_Event const &evt : replay->events_at(sim.tick)) {
+				handle_input(evt);
 			}
 		}
-	}
-
-	//player sprite:
-	if (animate) {
-		for (uint8_t xCount = 0; xCount < 2; ++xCount) {
-			for (uint8_t yCount = 0; yCount < 2; ++yCount) {
-				uint8_t ind = xCount + yCount * 2;
-				ppu.sprites[ind].x = int32_t(player_at.x + xCount) * 8;
-				ppu.sprites[ind].y = int32_t(player_at.y + yCount) * 8;
-				ppu.sprites[ind].index = ind;
-				ppu.sprites[ind].attributes = tile_to_palette_map[ind];
-
-				ppu.sprites[ind+4].x = int32_t(0);
-				ppu.sprites[ind+4].y = int32_t(241);
-				ppu.sprites[ind+4].index = ind+4;
-				ppu.sprites[ind + 4].attributes = tile_to_palette_map[ind + 4];
+		if (rewinding) {
+			//step back through the history (the tick count carries on, as with restart_level, so recordings stay in step):
+			uint32_t tick = sim.tick;
+			if (history.pop(rewind_state.get())) sim.load_state(*rewind_state);
+			sim.tick = tick + 1;
+		} else {
+			{
+				PROFILE_SCOPE("record rewind");
+				sim.save_state(rewind_state.get());
+				history.push(rewind_state.get());
 			}
+			sim.step();
 		}
-	}
-	else {
-		for (uint8_t xCount = 0; xCount < 2; ++xCount) {
-			for (uint8_t yCount = 0; yCount < 2; ++yCount) {
-				uint8_t ind = xCount + yCount * 2;
-				ppu.sprites[ind].x = int32_t(0);
-				ppu.sprites[ind].y = int32_t(241);
-				ppu.sprites[ind].index = ind;
-				ppu.sprites[ind].attributes = tile_to_palette_map[ind];
-
-				ppu.sprites[ind + 4].x = int32_t(player_at.x + xCount) * 8;
-				ppu.sprites[ind + 4].y = int32_t(player_at.y + yCount) * 8 ;
-				ppu.sprites[ind + 4].index = ind + 4;
-				ppu.sprites[ind + 4].attributes = tile_to_palette_map[ind + 4];
-			}
+		if (replay_finished()) {
+			float seconds = std::chrono::duration< float >(std::chrono::steady_clock::now() - replay_start).count();
+			uint32_t state = sim.state_checksum();
+			std::cout << "Replay finished: " << sim.tick << " ticks (" << sim.tick * Simulation::Tick << " s of play) in " << seconds << " s"
+				<< " (" << (sim.tick * Simulation::Tick) / std::max(seconds, 1e-6f) << "x real time); final state ";
+			if (replay->header.final_state == state) std::cout << "matches the recording." << std::endl;
+			else std::cout << "DIFFERS from the recording (" << state << " vs " << replay->header.final_state << ")." << std::endl;
 		}
 	}
-	int sprite_index = 8;
-	//draw boxes
-	int box_index = 0;
-	//std::cout << "drawing " << box_positions.size() << "boxes";
-	for (uint32_t i = 0; i < box_positions.size(); ++i) {
-		for (uint8_t xCount = 0; xCount < 2; ++xCount) {
-			for (uint8_t yCount = 0; yCount < 2; ++yCount) {
-				uint8_t offset = xCount + yCount * 2;
-				ppu.sprites[sprite_index].x = (uint8_t)box_positions[i].x + (xCount * 8);
-				ppu.sprites[sprite_index].y = (uint8_t)box_positions[i].y + (yCount * 8);
-				ppu.sprites[sprite_index].index = (box_index % 3) * 4 + 16 + offset;
-				ppu.sprites[sprite_index].attributes = tile_to_palette_map[(box_index % 3) * 4 + 16 + offset];
-				box_index++;
-			}
+}
+
+void PlayMode::draw(glm::uvec2 const &drawable_size) {
+	PROFILE_SCOPE("PlayMode::draw");
+
+	if (!playing) {
+		ppu.draw_loading(drawable_size, loader ? loader->progress() : 0.0f);
+		return;
+	}
+
+	update_camera();
+	stream_background();
+
+	//frame time overlay uses the last tiles before the background's blank tile (the last one), the last palette, and the last sprites:
+	// (apply_tables() clears tiles and palettes the tilebin doesn't use, so they only need to be free in the tilebin)
+	constexpr uint32_t OverlayTile = PPU466::TileCount - 1 - FrameStats::GlyphCount;
+	constexpr uint32_t OverlayPalette = PPU466::PaletteCount - 1;
+	constexpr uint32_t OverlaySprite = SpriteBatch::Slots - FrameStats::MaxSprites;
+	bool overlay = show_frame_stats && tile_to_palette_map.size() <= OverlayTile && tile_palettes_used <= OverlayPalette;
+
+	//entity sprites: each entity is a 16x16 metasprite showing its current animation frame:
+	// (when there are more than fit, the player always shows and the boxes take turns)
+	{
+		PROFILE_SCOPE("sprites");
+		Simulation::Entities const &entities = sim.entities;
+		sprite_batch.begin(overlay ? OverlaySprite : SpriteBatch::Slots);
+		for (uint32_t i = 0; i < entities.count; ++i) {
+			glm::ivec2 at = glm::ivec2(entities.position[i]) - camera;
+			uint8_t priority = (entities.kind[i] == EntityPlayer ? 255 : 0);
+			sprite_batch.submit(Metasprite16x16, entities.tile[i], at.x, at.y, 0, priority);
 		}
+		sprite_batch.end(&ppu, tile_to_palette_map);
 	}
 
-	//fill in rest
-	while (sprite_index < 64) {
-		ppu.sprites[sprite_index].y = 242;
-		sprite_index++;
+	if (overlay) {
+		frame_stats().draw_overlay(&ppu, OverlayTile, OverlayPalette, OverlaySprite);
 	}
 
 	//--- actually draw ---
 	ppu.draw(drawable_size);
 }
+
+void PlayMode::update_camera() {
+	//center on the player, but don't show past the edges of the level:
+	glm::ivec2 screen = glm::ivec2(PPU466::ScreenWidth, PPU466::ScreenHeight);
+	glm::ivec2 level_size = glm::ivec2(sim.level.width, sim.level.height) * 16;
+	glm::ivec2 target = glm::ivec2(0);
+	if (sim.entities.alive(sim.player)) {
+		target = glm::ivec2(sim.entities.position[sim.entities.index(sim.player)]) + glm::ivec2(8) - screen / 2;
+	}
+	camera = glm::max(glm::ivec2(0), glm::min(target, level_size - screen));
+}
+
+void PlayMode::stream_background() {
+	PROFILE_SCOPE("stream background");
+
+	//the visible tiles (plus one more column + row, for when the camera isn't tile-aligned):
+	constexpr int32_t WindowWidth = PPU466::ScreenWidth / 8 + 1;
+	constexpr int32_t WindowHeight = PPU466::ScreenHeight / 8 + 1;
+	static_assert(WindowWidth <= PPU466::BackgroundWidth && WindowHeight <= PPU466::BackgroundHeight, "window fits in the background");
+
+	auto write = [this](int32_t tx, int32_t ty) {
+		//(tx, ty are never negative, since the camera is clamped to the level)
+		ppu.background[(tx % PPU466::BackgroundWidth) + PPU466::BackgroundWidth * (ty % PPU466::BackgroundHeight)] = background_tile(tx, ty);
+	};
+	auto write_columns = [&](int32_t begin, int32_t end, int32_t bottom) {
+		for (int32_t tx = begin; tx < end; ++tx) {
+			for (int32_t ty = bottom; ty < bottom + WindowHeight; ++ty) write(tx, ty);
+		}
+	};
+	auto write_rows = [&](int32_t begin, int32_t end, int32_t left) {
+		for (int32_t ty = begin; ty < end; ++ty) {
+			for (int32_t tx = left; tx < left + WindowWidth; ++tx) write(tx, ty);
+		}
+	};
+
+	glm::ivec2 at = camera / 8;
+	glm::ivec2 moved = at - streamed_at;
+	if (!streamed || std::abs(moved.x) >= WindowWidth || std::abs(moved.y) >= WindowHeight) {
+		write_rows(at.y, at.y + WindowHeight, at.x);
+	} else {
+		//columns that came into view on the left or right, then rows that came into view on the bottom or top:
+		if (moved.x > 0) write_columns(streamed_at.x + WindowWidth, at.x + WindowWidth, at.y);
+		else if (moved.x < 0) write_columns(at.x, streamed_at.x, at.y);
+		if (moved.y > 0) write_rows(streamed_at.y + WindowHeight, at.y + WindowHeight, at.x);
+		else if (moved.y < 0) write_rows(at.y, streamed_at.y, at.x);
+	}
+	streamed_at = at;
+	streamed = true;
+
+	//(the ring repeats every 512x480 pixels, so keeping the position in that range looks the same)
+	ppu.background_position = -glm::ivec2(camera.x % int32_t(PPU466::BackgroundWidth * 8), camera.y % int32_t(PPU466::BackgroundHeight * 8));
+}
+
+uint16_t PlayMode::background_tile(int32_t tx, int32_t ty) const {
+	//each 16x16 cell is a 2x2 block of tiles:
+	int32_t cx = tx / 2;
+	int32_t cy = ty / 2;
+	uint32_t offset = uint32_t(tx % 2) + uint32_t(ty % 2) * 2;
+	uint32_t tile;
+	switch (sim.level.at(cx, cy)) {
+		case Level::TopBlock: tile = 8 + offset; break;
+		case Level::Block: tile = 12 + offset; break;
+		case Level::Ladder: tile = 28 + offset; break;
+		case Level::Hazard: tile = 32 + (uint32_t(cx + cy) % 3) * 4 + offset; break; //(three spike variants)
+		default: tile = 255; break;
+	}
+	if (tile >= tile_to_palette_map.size()) return (7 << 8) | 255; //blank
+	return uint16_t((tile_to_palette_map[tile] << 8) | tile);
+}
@@ -1,9 +1,19 @@
 #include "PPU466.hpp"
+#include "Metasprite.hpp"
 #include "Mode.hpp"
 #include "Level.hpp"
+#include "LevelPack.hpp"
+#include "Simulation.hpp"
+#include "TileBin.hpp"
+#include "TileBinLoader.hpp"
+#include "AssetWatcher.hpp"
+#include "InputReplay.hpp"
+#include "RewindBuffer.hpp"
 
 #include <glm/glm.hpp>
 
+#include <chrono>
+#include <memory>
 #include <vector>
 #include <deque>
 
@@ -16,35 +26,93 @@ struct PlayMode : Mode {
 	virtual void update(float elapsed) override;
 	virtual void draw(glm::uvec2 const &drawable_size) override;
 
+	//copy tables + levels from a (re-)loaded tilebin, touching only the entries that changed:
+	void apply_tilebin(TileBin const &bin);
+	//(the tables part of the above; returns counts of changed tiles and palettes)
+	glm::uvec2 apply_tables(TileBin const &bin);
+
+	//pick up tables + levels from the background loader as they arrive:
+	void take_loaded();
+
+	//switch to (and start) level 'index' of 'levels' ('N' goes to the next one):
+	void go_to_level(int32_t index);
+	//start the level in sim.level from the beginning (and remember that state in 'level_start'):
+	void start_level();
+	//go back to the start of the current level ('R'):
+	void restart_level();
+
+	//the game input part of handle_event (what gets recorded and replayed):
+	bool handle_input(SDL_Event const &);
+
 	//----- game state -----
 
-	//input tracking:
-	struct Button {
-		uint8_t downs = 0;
-		uint8_t pressed = 0;
-	} left, right, down, up;
-
-	//animation timer:
-	bool animate = false;
-	float animate_timer = 0.0f;
-
-	//player position:
-	glm::vec2 player_at = glm::vec2(0.0f);
-	glm::vec2 player_velocity = glm::vec2(0.0f);
-	float gravity = -5.0f;
-	//bool climb = false;
-	bool grounded = true; //also use this for the ladder
-
-	//boxes
-	std::vector<glm::vec2> box_positions;
-	std::vector<glm::vec2> box_velocities;
-	
-	//levels
-	std::vector<Level> levels;
+	//everything the game rules touch (stepped at a fixed rate, so runs can be recorded and replayed exactly):
+	Simulation sim;
+	float tick_accumulator = 0.0f; //time not yet stepped
+
+	//levels (decoded as they are needed; see LevelPack.hpp)
+	std::shared_ptr< LevelPack > levels;
 	int level_index = 1;
-	Level level; //track current level
+
+	//save states (fixed-size, so saving + restoring never allocate; each direction is a few kB of copying):
+	struct Snapshot {
+		Simulation::State sim;
+		int32_t level_index;
+		PPU466::State ppu;
+	};
+	void save_snapshot(Snapshot *snapshot) const;
+	void load_snapshot(Snapshot const &snapshot);
+	Snapshot level_start; //as of the last start_level()
+
+	//rewind (hold backspace): the state before each step is kept (delta-compressed) for up to a minute,
+	// and each tick spent rewinding restores the newest one:
+	static constexpr size_t RewindBytes = 4 << 20;
+	static constexpr uint32_t RewindFrames = 60 * 60;
+	RewindBuffer history;
+	std::unique_ptr< Simulation::State > rewind_state; //(value-initialized, so padding is always zero)
+	bool rewinding = false;
+	void print_rewind_stats() const; //(F4)
+
+	//record the input from here on, saving it to 'filename' when this mode is destroyed:
+	void record_replay(std::string const &filename);
+	std::unique_ptr< InputReplay > recording;
+	std::string recording_filename;
+
+	//play back a recording (live game input is ignored while replaying):
+	void play_replay(std::string const &filename);
+	bool replay_finished() const { return replay && sim.tick >= replay->header.ticks; }
+	std::unique_ptr< InputReplay > replay;
+	std::chrono::steady_clock::time_point replay_start;
+
+	//frame time overlay (toggled with F3):
+	bool show_frame_stats = false;
+
+	//false until the tables and the first level have arrived from 'loader':
+	bool playing = false;
 
 	//----- drawing handled by PPU466 -----
 	std::vector<int> tile_to_palette_map;
+	uint32_t tile_palettes_used = 0; //palettes the tilebin fills (the rest are free)
 	PPU466 ppu;
+	SpriteBatch sprite_batch; //packs entities' metasprites into ppu.sprites
+
+	//----- scrolling -----
+	//the camera follows the player, and ppu.background is used as a ring that wraps around under it:
+	// only the tile columns + rows that scroll into view are written, so each frame's background writes
+	// depend on how far the camera moved (at most a screen edge or two), not on the size of the level.
+	glm::ivec2 camera = glm::ivec2(0); //level pixel at the lower left of the screen
+	glm::ivec2 streamed_at = glm::ivec2(0); //lower-left level tile of the window currently in ppu.background
+	bool streamed = false; //false => rewrite the whole window on the next draw (new level, new palettes, ...)
+	void update_camera();
+	void stream_background();
+	uint16_t background_tile(int32_t tx, int32_t ty) const; //ppu.background entry for level tile (tx, ty)
+
+	//----- loads tilebin in the background at startup (reset once finished) -----
+	std::unique_ptr< TileBinLoader > loader;
+	std::chrono::steady_clock::time_point load_start;
+
+	//----- rebuilds + reloads tilebin when the art changes -----
+	//(only when asked for with --watch: a mid-run reload would make recordings, replays, and benchmarks diverge)
+	void watch_assets();
+	std::unique_ptr< AssetWatcher > asset_watcher;
 };
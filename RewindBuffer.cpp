@@ -0,0 +1,223 @@
+#include "RewindBuffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	//runs of fewer zero bytes than this are cheaper to leave inside a literal:
+	constexpr size_t MinZeroRun = 4;
+
+	void put_varint(size_t value, uint8_t *&at) {
+		while (value >= 0x80) {
+			*(at++) = uint8_t(value & 0x7f) | 0x80;
+			value >>= 7;
+		}
+		*(at++) = uint8_t(value);
+	}
+
+	size_t get_varint(uint8_t const *&at) {
+		size_t value = 0;
+		for (uint32_t shift = 0; ; shift += 7) {
+			uint8_t byte = *(at++);
+			value |= size_t(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) return value;
+		}
+	}
+
+	//length of the run of equal bytes in a and b starting at 'i' (word at a time):
+	size_t same_run(uint8_t const *a, uint8_t const *b, size_t i, size_t size) {
+		size_t start = i;
+		while (i + 64 <= size && std::memcmp(a + i, b + i, 64) == 0) i += 64; //(memcmp is vectorized, so big unchanged stretches go fast)
+		while (i + 8 <= size) {
+			uint64_t wa, wb;
+			std::memcpy(&wa, a + i, 8);
+			std::memcpy(&wb, b + i, 8);
+			if (wa != wb) break;
+			i += 8;
+		}
+		while (i < size && a[i] == b[i]) ++i;
+		return i - start;
+	}
+
+	//encode (state XOR base) into 'out', returning the encoded size:
+	size_t encode(uint8_t const *state, uint8_t const *base, size_t size, uint8_t *out) {
+		uint8_t *at = out;
+		size_t i = 0;
+		while (i < size) {
+			//run of unchanged bytes:
+			size_t zeros = same_run(state, base, i, size);
+			size_t begin = i + zeros;
+			//run of changed bytes (short unchanged runs are folded in; ends at a longer one or the end of the state):
+			size_t end = begin;
+			while (end < size) {
+				if (state[end] != base[end]) {
+					++end;
+					continue;
+				}
+				size_t same = 0;
+				while (end + same < size && same < MinZeroRun && state[end + same] == base[end + same]) ++same;
+				if (same >= MinZeroRun || end + same == size) break;
+				end += same;
+			}
+			put_varint(zeros, at);
+			put_varint(end - begin, at);
+			for (size_t k = begin; k < end; ++k) {
+				*(at++) = state[k] ^ base[k];
+			}
+			i = end;
+		}
+		return size_t(at - out);
+	}
+
+	//decode over 'out', which should already hold the base:
+	void decode(uint8_t const *in, size_t in_size, uint8_t *out, size_t size) {
+		uint8_t const *at = in;
+		uint8_t const *end = in + in_size;
+		size_t i = 0;
+		while (at < end) {
+			i += get_varint(at);
+			size_t literal = get_varint(at);
+			assert(i + literal <= size);
+			for (size_t k = 0; k < literal; ++k) {
+				out[i + k] ^= *(at++);
+			}
+			i += literal;
+		}
+		assert(i == size);
+		(void)size;
+	}
+}
+
+RewindBuffer::RewindBuffer(size_t state_size_, size_t arena_bytes, uint32_t max_frames, uint32_t keyframe_interval_)
+	: state_size(state_size_), keyframe_interval(std::max(1u, keyframe_interval_)) {
+	if (arena_bytes > 0xffffffffu) throw std::runtime_error("RewindBuffer arena too large.");
+	arena.resize(arena_bytes);
+	ring.resize(std::max(1u, max_frames));
+	key_state.resize(state_size);
+	base.resize(state_size, 0);
+	//worst case: one literal covering everything (plus its two varints):
+	scratch.resize(state_size + 2 * 10);
+}
+
+void RewindBuffer::clear() {
+	first = 0;
+	count = 0;
+	since_keyframe = 0;
+	head = 0;
+}
+
+void RewindBuffer::set_base(void const *state) {
+	//(existing keyframes were encoded against the old base, so they have to go)
+	clear();
+	std::memcpy(base.data(), state, state_size);
+}
+
+size_t RewindBuffer::bytes_used() const {
+	if (count == 0) return 0;
+	Frame const &oldest = ring[first];
+	if (head > oldest.offset) return head - oldest.offset;
+	return (arena.size() - oldest.offset) + head; //(wrapped; counts the unused end of the arena as used)
+}
+
+void RewindBuffer::drop_oldest_group() {
+	assert(count > 0);
+	do {
+		first = (first + 1) % ring.size();
+		count -= 1;
+		stats.dropped += 1;
+	} while (count > 0 && !ring[first].keyframe);
+	if (count == 0) {
+		since_keyframe = 0;
+		head = 0;
+	}
+}
+
+uint32_t RewindBuffer::allocate(uint32_t size) {
+	if (size > arena.size()) throw std::runtime_error("RewindBuffer arena is smaller than one state.");
+	while (true) {
+		if (count == 0) {
+			head = 0;
+			return 0;
+		}
+		uint32_t tail = ring[first].offset; //oldest byte still in use
+		if (head > tail) {
+			//used region is [tail, head); free is [head, end) + [0, tail):
+			if (arena.size() - head >= size) return head;
+			if (tail >= size) return 0;
+		} else if (head < tail) {
+			//used region wraps: free is [head, tail):
+			if (tail - head >= size) return head;
+		}
+		//(head == tail with frames present means the arena is exactly full)
+		drop_oldest_group();
+	}
+}
+
+void RewindBuffer::push(void const *state_) {
+	uint8_t const *state = reinterpret_cast< uint8_t const * >(state_);
+
+	if (count == ring.size()) drop_oldest_group();
+
+	bool keyframe = (count == 0 || since_keyframe >= keyframe_interval);
+	size_t size = encode(state, keyframe ? base.data() : key_state.data(), state_size, scratch.data());
+
+	uint32_t offset = allocate(uint32_t(size));
+	//(dropping groups may have emptied the buffer, in which case there is no keyframe left to be relative to)
+	if (!keyframe && count == 0) {
+		keyframe = true;
+		size = encode(state, base.data(), state_size, scratch.data());
+		offset = allocate(uint32_t(size));
+	}
+	std::memcpy(arena.data() + offset, scratch.data(), size);
+	head = offset + uint32_t(size);
+
+	Frame &frame = ring[(first + count) % ring.size()];
+	frame.offset = offset;
+	frame.size = uint32_t(size);
+	frame.keyframe = keyframe;
+	count += 1;
+
+	if (keyframe) {
+		std::memcpy(key_state.data(), state, state_size);
+		since_keyframe = 1;
+		stats.keyframes += 1;
+		stats.keyframe_bytes += size;
+	} else {
+		since_keyframe += 1;
+		stats.deltas += 1;
+		stats.delta_bytes += size;
+	}
+}
+
+bool RewindBuffer::pop(void *state_) {
+	if (count == 0) return false;
+	uint8_t *state = reinterpret_cast< uint8_t * >(state_);
+
+	Frame newest = frame(count - 1);
+	std::memcpy(state, key_state.data(), state_size);
+	if (!newest.keyframe) {
+		decode(arena.data() + newest.offset, newest.size, state, state_size);
+	}
+	count -= 1;
+	head = newest.offset;
+	since_keyframe -= 1;
+
+	//popped a keyframe? the next newest state belongs to the previous group, so decode that group's keyframe:
+	if (newest.keyframe && count > 0) {
+		uint32_t k = count - 1;
+		while (!frame(k).keyframe) {
+			assert(k > 0 && "oldest state is always a keyframe");
+			k -= 1;
+		}
+		std::memcpy(key_state.data(), base.data(), state_size);
+		decode(arena.data() + frame(k).offset, frame(k).size, key_state.data(), state_size);
+		since_keyframe = count - k;
+	}
+	if (count == 0) {
+		since_keyframe = 0;
+		head = 0;
+	}
+	return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+/*
+ * RewindBuffer -- a bounded history of fixed-size state blocks (e.g., Simulation::State), newest last.
+ *
+ * States are stored as byte-wise XOR deltas, run-length encoded so that unchanged bytes cost nothing:
+ *  - every 'keyframe_interval'th state is a keyframe (delta against a fixed base state -- all zeros unless set_base() is used);
+ *  - the rest are deltas against their group's keyframe, so any state decodes with one keyframe + one delta.
+ * Encoded states go in a fixed-size circular byte arena; when it (or the frame index) fills up,
+ * the oldest keyframe group is dropped. Nothing allocates after construction.
+ *
+ * //e.g.:
+ * RewindBuffer history(sizeof(Simulation::State), 4 << 20, 60 * 60);
+ * history.push(&state); //each tick
+ * if (history.pop(&state)) { ... } //step back one
+ *
+ * Encoding: a sequence of (zero-run length, literal length, literal bytes...), lengths as varints,
+ * covering the whole state. Blocks should have deterministic padding (e.g., be value-initialized)
+ * so that padding doesn't show up as changes.
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct RewindBuffer {
+	//states are 'state_size' bytes; at most 'arena_bytes' of encoded data and 'max_frames' states are kept:
+	RewindBuffer(size_t state_size, size_t arena_bytes, uint32_t max_frames, uint32_t keyframe_interval = 60);
+
+	//add a state as the newest:
+	void push(void const *state);
+
+	//copy the newest state to 'state' and remove it (returns false if empty):
+	bool pop(void *state);
+
+	//forget everything:
+	void clear();
+
+	//keyframes are stored as deltas against this state (all zeros by default);
+	// setting it to a typical state (e.g., a freshly constructed one) makes keyframes much smaller:
+	void set_base(void const *state);
+
+	uint32_t frames() const { return count; }
+
+	//running totals (for a bytes-per-frame readout):
+	struct Stats {
+		uint64_t keyframes = 0, keyframe_bytes = 0;
+		uint64_t deltas = 0, delta_bytes = 0;
+		uint64_t dropped = 0; //states dropped to make room
+	} stats;
+	size_t bytes_used() const; //arena bytes currently holding states
+	size_t arena_size() const { return arena.size(); }
+
+	//----- internals -----
+	struct Frame {
+		uint32_t offset = 0; //in arena
+		uint32_t size = 0; //encoded bytes
+		bool keyframe = false;
+	};
+	size_t state_size;
+	uint32_t keyframe_interval;
+	std::vector< uint8_t > arena;
+	std::vector< Frame > ring; //frame index; oldest at 'first'
+	uint32_t first = 0;
+	uint32_t count = 0;
+	uint32_t since_keyframe = 0; //states pushed since (and including) the newest keyframe
+	uint32_t head = 0; //next free byte in arena
+	std::vector< uint8_t > key_state; //decoded keyframe of the newest group
+	std::vector< uint8_t > base; //(keyframes are deltas against this)
+	std::vector< uint8_t > scratch; //encoding space
+
+	Frame &frame(uint32_t i) { return ring[(first + i) % ring.size()]; } //i-th oldest
+	uint32_t allocate(uint32_t size); //find room for 'size' bytes (dropping old groups as needed)
+	void drop_oldest_group();
+};
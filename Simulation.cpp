@@ -0,0 +1,100 @@
+#include "Simulation.hpp"
+
+#include "crc32c.hpp"
+
+constexpr float Simulation::Tick;
+constexpr uint32_t Simulation::MaxEntities;
+
+void Simulation::reset_level() {
+	entities.clear();
+
+	player = entities.create();
+	{
+		uint32_t i = entities.index(player);
+		entities.position[i] = level.starting_pos * 8.0f; //(level positions are in 8-pixel tiles)
+		entities.kind[i] = EntityPlayer;
+		entities.flags[i] = EntityAnimated;
+		entities.tile[i] = 0; //(cat tiles 0-7; used as-is if there's no "cat" clip)
+		play(animations, &entities, i, animations.find("cat"));
+	}
+
+	uint32_t boxes = 0;
+	for (uint32_t y = 0; y < level.height; ++y) {
+		for (uint32_t x = 0; x < level.width; ++x) {
+			if (level.cells[x + y * level.width] == Level::Box) {
+				uint32_t i = entities.index(entities.create());
+				entities.position[i] = glm::vec2(x * 16, y * 16);
+				entities.kind[i] = EntityBox;
+				entities.tile[i] = uint8_t(16 + (boxes % 3) * 4); //(three box variants, tiles 16-27)
+				boxes += 1;
+			}
+		}
+	}
+}
+
+void Simulation::step() {
+	float elapsed = Tick;
+	uint32_t const count = entities.count;
+
+	//input steers the player:
+	constexpr float PlayerSpeed = 240.0f; //pixels / second
+	glm::vec2 dir = glm::vec2(0.0f);
+	if (left.pressed) dir.x -= 1.0f;
+	if (right.pressed) dir.x += 1.0f;
+	if (down.pressed) dir.y -= 1.0f;
+	if (up.pressed) dir.y += 1.0f;
+	entities.velocity[entities.index(player)] = PlayerSpeed * dir;
+
+	//reset button press counters:
+	left.downs = 0;
+	right.downs = 0;
+	up.downs = 0;
+	down.downs = 0;
+
+	//gravity:
+	for (uint32_t i = 0; i < count; ++i) {
+		if (entities.flags[i] & EntityFalls) entities.velocity[i].y += gravity * elapsed;
+	}
+
+	//movement:
+	for (uint32_t i = 0; i < count; ++i) {
+		entities.position[i] += entities.velocity[i] * elapsed;
+	}
+
+	//animation:
+	animate(animations, &entities);
+
+	//I would put the code here for character and scene collision and whatnot but I spent too much time trying to get the PPU to display my sprites and also other life things
+	//but essentially I would check if object[character_x][character_y] +- some buffer, do something like make character grounded.
+
+	tick += 1;
+}
+
+void Simulation::save_state(State *state) const {
+	state->tick = tick;
+	state->gravity = gravity;
+	state->player = player;
+	state->entities = entities;
+}
+
+void Simulation::load_state(State const &state) {
+	tick = state.tick;
+	gravity = state.gravity;
+	player = state.player;
+	entities = state.entities;
+}
+
+uint32_t Simulation::state_checksum() const {
+	//(only the live part of each pool counts)
+	uint32_t const count = entities.count;
+	uint32_t crc = 0;
+	crc = crc32c(&count, sizeof(count), crc);
+	crc = crc32c(entities.position.data(), count * sizeof(glm::vec2), crc);
+	crc = crc32c(entities.velocity.data(), count * sizeof(glm::vec2), crc);
+	crc = crc32c(entities.kind.data(), count, crc);
+	crc = crc32c(entities.tile.data(), count, crc);
+	crc = crc32c(entities.clip.data(), count * sizeof(uint16_t), crc);
+	crc = crc32c(entities.frame.data(), count * sizeof(uint16_t), crc);
+	crc = crc32c(entities.frame_ticks.data(), count * sizeof(uint16_t), crc);
+	return crc;
+}
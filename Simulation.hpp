@@ -0,0 +1,70 @@
+#pragma once
+
+/*
+ * Simulation -- the game's state and rules, without windowing or drawing.
+ *
+ * PlayMode owns one, feeds it input, and draws it with the PPU;
+ * the headless 'simulate' utility (see simulate.cpp) steps many of them at once.
+ *
+ * Everything advances in fixed steps of 'Tick' seconds, so the same input before the same steps
+ * always ends in the same state (which is what makes InputReplay work).
+ *
+ */
+
+#include "Level.hpp"
+#include "EntityStore.hpp"
+#include "Animation.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+struct Simulation {
+	//seconds per step():
+	static constexpr float Tick = 1.0f / 60.0f;
+
+	//put the player and boxes at their starting positions in 'level':
+	// (throws if the level has more boxes than fit in 'entities')
+	void reset_level();
+
+	//advance by one Tick:
+	void step();
+
+	//hash of the state (for checking that two runs ended up in the same place):
+	uint32_t state_checksum() const;
+
+	//the player plus one entity per box:
+	static constexpr uint32_t MaxEntities = 256; //(a player and up to 255 boxes per level)
+	typedef EntityStore< MaxEntities > Entities;
+
+	//save states:
+	// everything except input and the level, as one fixed-size block (no pointers, so saving + restoring never allocate):
+	// (the level never changes while it is played, so it isn't part of the state)
+	struct State {
+		uint32_t tick;
+		float gravity;
+		EntityHandle player;
+		Entities entities;
+	};
+	void save_state(State *state) const;
+	void load_state(State const &state);
+
+	//input tracking:
+	struct Button {
+		uint8_t downs = 0;
+		uint8_t pressed = 0;
+	} left, right, down, up;
+
+	//steps taken so far:
+	uint32_t tick = 0;
+
+	//pulls on entities with EntityFalls (pixels / second^2):
+	float gravity = -40.0f;
+
+	//the player and boxes (see EntityStore.hpp):
+	Entities entities;
+	EntityHandle player;
+
+	Level level; //track current level (set before reset_level())
+	AnimationTable animations; //clips entities play (like the level, not part of the state)
+};
@@ -0,0 +1,34 @@
+#include "TileBin.hpp"
+
+#include "ChunkFile.hpp"
+
+#include <cassert>
+
+void TileBin::load(std::string const &filename) {
+	//map the file and copy the small tables out of it (the tile index image and the level pack keep it mapped):
+	std::shared_ptr< ChunkFile const > in(new ChunkFile(filename));
+	load_tables(in);
+	load_levels(in);
+}
+
+void TileBin::load_tables(std::shared_ptr< ChunkFile const > const &in_) {
+	assert(in_);
+	ChunkFile const &in = *in_;
+	std::string const &filename = in.filename;
+	read_chunk(in, "tile", &tile_table);
+	//the tile index image is uploaded straight from the mapping, so it isn't copied (or compressed):
+	tile_indices = in.get< PPU466::TileIndices >("tidx");
+	file = in_;
+	read_chunk(in, "pale", &palette_table);
+	read_chunk(in, "tmap", &tile_to_palette_map);
+	animations.load(in);
+
+	if (tile_table.size() > std::tuple_size< decltype(PPU466::tile_table) >::value) throw std::runtime_error("'" + filename + "' has more tiles than the PPU.");
+	if (tile_indices.size != 1) throw std::runtime_error("'" + filename + "' should have exactly one tile index image.");
+	if (palette_table.size() > std::tuple_size< decltype(PPU466::palette_table) >::value) throw std::runtime_error("'" + filename + "' has more palettes than the PPU.");
+	if (tile_to_palette_map.size() != tile_table.size()) throw std::runtime_error("'" + filename + "' should map every tile to a palette.");
+}
+
+void TileBin::load_levels(std::shared_ptr< ChunkFile const > const &in) {
+	levels.reset(new LevelPack(in));
+}
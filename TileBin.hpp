@@ -0,0 +1,35 @@
+#pragma once
+
+/*
+ * TileBin holds everything process_assets writes into 'tilebin'.
+ *
+ */
+
+#include "PPU466.hpp"
+#include "ChunkFile.hpp"
+#include "LevelPack.hpp"
+#include "Animation.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct TileBin {
+	std::vector< PPU466::Tile > tile_table;
+	ChunkFile::Span< PPU466::TileIndices > tile_indices; //one 128x128 image, pre-expanded from tile_table (used in place from 'file')
+	std::vector< PPU466::Palette > palette_table;
+	std::vector< int > tile_to_palette_map;
+	AnimationTable animations;
+	std::shared_ptr< LevelPack > levels; //(decoded on demand; keeps the file mapped)
+	std::shared_ptr< ChunkFile const > file; //keeps tile_indices mapped
+
+	//read the tables and the level table from a tilebin file:
+	// (throws on error)
+	void load(std::string const &filename);
+
+	//...or in two steps, as TileBinLoader does:
+	//tiles, tile indices, palettes, tile map, and animation clips:
+	void load_tables(std::shared_ptr< ChunkFile const > const &in);
+	//the level table (levels themselves are decoded by LevelPack::get):
+	void load_levels(std::shared_ptr< ChunkFile const > const &in);
+};
@@ -0,0 +1,96 @@
+#include "TileBinLoader.hpp"
+
+#include "ChunkFile.hpp"
+#include "startup_profile.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+TileBinLoader::TileBinLoader(std::string const &filename_) : filename(filename_) {
+	startup_pending_begin(); //(startup isn't over until the tilebin is loaded)
+	thread = std::thread(&TileBinLoader::load, this);
+}
+
+TileBinLoader::~TileBinLoader() {
+	quit = true;
+	if (thread.joinable()) thread.join();
+}
+
+bool TileBinLoader::take(TileBin *bin) {
+	assert(bin);
+	if (taken_all) return false;
+
+	std::lock_guard< std::mutex > lock(ready_mutex);
+	if (error) {
+		taken_all = true;
+		std::rethrow_exception(error);
+	}
+
+	bool took = false;
+	if (tables_ready) {
+		bin->tile_table = std::move(ready.tile_table);
+		bin->tile_indices = ready.tile_indices;
+		bin->file = std::move(ready.file);
+		bin->palette_table = std::move(ready.palette_table);
+		bin->tile_to_palette_map = std::move(ready.tile_to_palette_map);
+		bin->animations = std::move(ready.animations);
+		tables_ready = false;
+		took = true;
+	}
+	if (levels_done) {
+		bin->levels = std::move(ready.levels);
+		levels_done = false;
+		taken_all = true;
+		took = true;
+	}
+	return took;
+}
+
+float TileBinLoader::progress() const {
+	uint32_t total = total_bytes;
+	if (total == 0) return 0.0f;
+	return std::min(1.0f, float(loaded_bytes) / float(total));
+}
+
+void TileBinLoader::load() {
+	trace_thread_name("tilebin loader");
+	TraceClock::time_point start = TraceClock::now();
+	try {
+		std::shared_ptr< ChunkFile const > in(new ChunkFile(filename));
+		for (auto const &chunk : in->chunks) {
+			if (chunk.magic == "lvlc") continue; //(levels are decoded later, one at a time, by LevelPack)
+			total_bytes += chunk.size;
+		}
+
+		TileBin bin;
+		bin.load_tables(in);
+		uint32_t tables = startup_record("tilebin tables", "tilebin", start, TraceClock::now(), startup_bytes_read());
+		{
+			std::lock_guard< std::mutex > lock(ready_mutex);
+			ready.tile_table = bin.tile_table;
+			ready.tile_indices = bin.tile_indices;
+			ready.file = bin.file;
+			ready.palette_table = bin.palette_table;
+			ready.tile_to_palette_map = bin.tile_to_palette_map;
+			ready.animations = bin.animations;
+			tables_ready = true;
+		}
+		ChunkFile::Chunk const *header_chunk = in->find("lvlh");
+		loaded_bytes = total_bytes - (header_chunk ? header_chunk->size : 0);
+
+		if (!quit) {
+			TraceClock::time_point levels_start = TraceClock::now();
+			bin.load_levels(in);
+			startup_record("tilebin level table", "tilebin", levels_start, TraceClock::now(), 0, { tables });
+			loaded_bytes = uint32_t(total_bytes);
+
+			std::lock_guard< std::mutex > lock(ready_mutex);
+			ready.levels = bin.levels;
+			levels_done = true;
+		}
+	} catch (...) {
+		std::lock_guard< std::mutex > lock(ready_mutex);
+		error = std::current_exception();
+	}
+	startup_pending_end();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+/*
+ * TileBinLoader -- reads 'tilebin' on a background thread, handing it to the main thread in pieces.
+ *
+ * The tables (tiles, tile indices, palettes, tile map) are small and arrive first, all at once;
+ * levels follow a few at a time as they are decompressed, so the game can start on level 0
+ * without waiting for the rest of the level pack.
+ *
+ * //e.g.:
+ * TileBinLoader loader(data_path("../tilebin"));
+ * //...each update:
+ * TileBin got;
+ * if (loader.take(&got)) { ... got.tile_table (if !got.tile_indices.empty()), got.levels ... }
+ *
+ */
+
+#include "TileBin.hpp"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct TileBinLoader {
+	explicit TileBinLoader(std::string const &filename);
+	~TileBinLoader(); //stops loading early if not finished
+
+	//move whatever has been loaded since the last call into 'bin':
+	// - the tables (tile_table, tile_indices, palette_table, tile_to_palette_map) are moved in once, when ready
+	// - the level pack is moved into bin->levels once its table has been read
+	//returns true if anything was moved; rethrows any error from the loading thread.
+	// (call from the main thread, e.g., once per update)
+	bool take(TileBin *bin);
+
+	//approximate fraction [0,1] of the tilebin that has been loaded:
+	float progress() const;
+
+	//true once take() has handed over everything:
+	bool finished() const { return taken_all; }
+
+	//----- internals -----
+	void load(); //background thread's main function
+
+	std::string filename;
+
+	std::mutex ready_mutex;
+	TileBin ready; //<-- guarded by ready_mutex: loaded but not yet taken
+	bool tables_ready = false; //<-- guarded by ready_mutex
+	bool levels_done = false; //<-- guarded by ready_mutex (level pack is in 'ready')
+	std::exception_ptr error; //<-- guarded by ready_mutex
+
+	bool taken_all = false; //main thread only
+
+	//progress, in bytes of the tilebin's chunks:
+	std::atomic< uint32_t > loaded_bytes{0};
+	std::atomic< uint32_t > total_bytes{0};
+
+	std::atomic< bool > quit{false};
+	std::thread thread;
+};
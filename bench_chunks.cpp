@@ -0,0 +1,108 @@
+// compares file size and load time of raw vs. compressed levels for a large (synthetic) level pack:
+// the time to open the pack and get the first level (what startup waits for) and to decode every level
+// (loads include checksum validation; checksum throughput is reported on its own at the end)
+//  usage: bench_chunks [levels] [repeats]
+#include "read_write_chunk.hpp"
+#include "ChunkFile.hpp"
+#include "crc32c.hpp"
+#include "data_path.hpp"
+#include "Level.hpp"
+#include "LevelPack.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv) {
+	uint32_t level_count = (argc > 1 ? uint32_t(std::stoul(argv[1])) : 2000);
+	uint32_t repeats = (argc > 2 ? uint32_t(std::stoul(argv[2])) : 20);
+
+	//levels that look roughly like hand-made ones: a floor, a few platforms, ladders, hazards, and boxes:
+	std::vector< Level > levels(level_count);
+	std::mt19937 mt(0x466);
+	for (auto &level : levels) {
+		auto cell = [&level](uint32_t x, uint32_t y) -> uint8_t & { return level.cells[x + y * level.width]; };
+		for (uint32_t x = 0; x < 16; ++x) cell(x, 0) = Level::Block;
+		for (uint32_t p = 0; p < 4; ++p) {
+			uint32_t x0 = mt() % 12, y = 2 + mt() % 12, w = 2 + mt() % 4;
+			for (uint32_t x = x0; x < x0 + w && x < 16; ++x) cell(x, y) = Level::TopBlock;
+			cell(x0, y - 1) = Level::Ladder;
+		}
+		for (uint32_t h = 0; h < 3; ++h) cell(mt() % 16, 1) = Level::Hazard;
+		for (uint32_t b = 0; b < 5; ++b) cell(mt() % 16, 1 + mt() % 14) = Level::Box;
+		level.starting_pos = glm::vec2(float(2 * (mt() % 16)), 2.0f);
+	}
+	struct Variant {
+		std::string name;
+		ChunkCodec codec;
+	};
+	for (Variant const &variant : { Variant{"raw", ChunkCodecRaw}, Variant{"deflate", ChunkCodecDeflate} }) {
+		std::string filename = data_path("bench-" + variant.name + ".chunks");
+		std::vector< LevelHeader > headers;
+		std::vector< uint8_t > records;
+		pack_levels(levels, variant.codec, &headers, &records);
+		{
+			std::ofstream out(filename, std::ios::binary);
+			ChunkWriter writer(&out);
+			writer.write("lvlh", headers);
+			writer.write("lvlc", records);
+			writer.finish();
+		}
+		size_t file_size = 0;
+		{
+			std::ifstream in(filename, std::ios::binary | std::ios::ate);
+			file_size = size_t(in.tellg());
+		}
+
+		//(file will be in the OS cache after writing, so this measures decode cost rather than disk speed)
+		double first_best = 1e30, all_best = 1e30, all_total = 0.0;
+		std::vector< Level > loaded;
+		for (uint32_t r = 0; r < repeats; ++r) {
+			auto before = std::chrono::high_resolution_clock::now();
+			LevelPack pack(std::make_shared< ChunkFile >(filename));
+			loaded.clear();
+			loaded.emplace_back(*pack.get(0));
+			auto first = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 1; i < pack.size(); ++i) {
+				loaded.emplace_back(*pack.get(i));
+			}
+			auto after = std::chrono::high_resolution_clock::now();
+			first_best = std::min(first_best, std::chrono::duration< double, std::milli >(first - before).count());
+			double ms = std::chrono::duration< double, std::milli >(after - before).count();
+			all_best = std::min(all_best, ms);
+			all_total += ms;
+		}
+		if (loaded != levels) {
+			std::cerr << "ERROR: " << variant.name << " levels didn't round-trip." << std::endl;
+			return 1;
+		}
+
+		std::cout << variant.name << ": " << level_count << " levels, " << file_size << " bytes ("
+			<< (file_size / double(level_count)) << " bytes/level); first level " << first_best << " ms best; all levels "
+			<< all_best << " ms best / " << (all_total / repeats) << " ms average over " << repeats << " runs." << std::endl;
+		std::remove(filename.c_str());
+	}
+
+	{ //checksum speed (i.e., what validation costs per byte loaded):
+		std::vector< uint8_t > cells;
+		for (auto const &level : levels) cells.insert(cells.end(), level.cells.begin(), level.cells.end());
+		size_t bytes = cells.size();
+		double best = 1e30;
+		uint32_t crc = 0;
+		for (uint32_t r = 0; r < repeats; ++r) {
+			auto before = std::chrono::high_resolution_clock::now();
+			crc = crc32c(cells.data(), bytes);
+			auto after = std::chrono::high_resolution_clock::now();
+			best = std::min(best, std::chrono::duration< double, std::milli >(after - before).count());
+		}
+		std::cout << "crc32c: " << bytes << " bytes in " << best << " ms best ("
+			<< (bytes / (best * 1e-3) / 1e9) << " GB/s, crc " << std::hex << crc << std::dec << ")" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,134 @@
+// measures PPU frame time as its capacity grows: PPU466, an in-between mode, and PPUExtended,
+// each with every tile and palette in use, a full background, and every sprite on screen and moving
+// (so the vertex stream changes every frame, as in a game); each mode is still one draw call
+// frame time is draw() plus glFinish(), so it includes the GPU's work; the first frame (which builds + uploads the tiles) is reported separately
+//  usage: bench_ppu [frames]
+//  (needs OpenGL; without a display, try SDL_VIDEODRIVER=offscreen LIBGL_ALWAYS_SOFTWARE=1 utils/bench_ppu)
+#include "PPU466.hpp"
+#include "Load.hpp"
+#include "GL.hpp"
+#include "gl_profile.hpp"
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+template< typename Mode >
+void bench(std::string const &name, uint32_t frames, glm::uvec2 const &drawable_size) {
+	std::unique_ptr< Mode > ppu(new Mode); //(the bigger modes are too large for the stack)
+
+	std::mt19937 mt(0x466);
+	for (auto &tile : ppu->tile_table) {
+		for (uint32_t y = 0; y < 8; ++y) {
+			tile.bit0[y] = uint8_t(mt());
+			tile.bit1[y] = uint8_t(mt());
+		}
+	}
+	for (auto &palette : ppu->palette_table) {
+		palette[0] = glm::u8vec4(0x00, 0x00, 0x00, 0x00);
+		for (uint32_t c = 1; c < 4; ++c) {
+			palette[c] = glm::u8vec4(uint8_t(mt()), uint8_t(mt()), uint8_t(mt()), 0xff);
+		}
+	}
+	for (auto &entry : ppu->background) {
+		entry = typename Mode::BackgroundEntry((mt() % Mode::TileCount) | ((mt() % Mode::PaletteCount) << Mode::PaletteShift));
+	}
+	for (auto &sprite : ppu->sprites) {
+		sprite.x = uint8_t(mt() % (Mode::ScreenWidth - 8));
+		sprite.y = uint8_t(mt() % (Mode::ScreenHeight - 8));
+		sprite.index = typename Mode::TileIndex(mt() % Mode::TileCount);
+		sprite.attributes = uint8_t((mt() % Mode::PaletteCount) | (mt() % 4 == 0 ? 0x80 : 0x00));
+	}
+
+	auto draw = [&]() -> double {
+		auto before = std::chrono::high_resolution_clock::now();
+		ppu->draw(drawable_size);
+		glFinish();
+		auto after = std::chrono::high_resolution_clock::now();
+		gl_profile_collect();
+		return std::chrono::duration< double, std::milli >(after - before).count();
+	};
+
+	double first_ms = draw();
+
+	std::vector< double > ms;
+	ms.reserve(frames);
+	for (uint32_t f = 0; f < frames; ++f) {
+		//scroll the background and move every sprite:
+		ppu->background_position = glm::ivec2(-int32_t(f), -int32_t(f / 2));
+		for (auto &sprite : ppu->sprites) {
+			sprite.x = uint8_t((sprite.x + 1) % (Mode::ScreenWidth - 8));
+		}
+		ms.emplace_back(draw());
+	}
+	std::sort(ms.begin(), ms.end());
+	double total = 0.0;
+	for (double m : ms) total += m;
+
+	std::cout << std::left << std::setw(12) << name << std::right
+		<< std::setw(7) << Mode::TileCount << std::setw(6) << Mode::PaletteCount << std::setw(8) << Mode::SpriteCount
+		<< std::setw(11) << first_ms << std::setw(10) << (total / ms.size())
+		<< std::setw(9) << ms[ms.size() / 2] << std::setw(9) << ms[std::min(ms.size() - 1, ms.size() * 99 / 100)] << std::endl;
+}
+
+int main(int argc, char **argv) {
+	uint32_t frames = (argc > 1 ? uint32_t(std::max(1, std::atoi(argv[1]))) : 1000);
+
+	SDL_Init(SDL_INIT_VIDEO);
+
+	SDL_GL_ResetAttributes();
+	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+
+	//same size as the game's window, but hidden:
+	SDL_Window *window = SDL_CreateWindow(
+		"bench_ppu",
+		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+		2*PPU466::ScreenWidth + 8, 2*PPU466::ScreenHeight + 8,
+		SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN
+	);
+	if (!window) {
+		std::cerr << "Error creating SDL window: " << SDL_GetError() << std::endl;
+		return 1;
+	}
+	SDL_GLContext context = SDL_GL_CreateContext(window);
+	if (!context) {
+		SDL_DestroyWindow(window);
+		std::cerr << "Error creating OpenGL context: " << SDL_GetError() << std::endl;
+		std::cerr << "(Without a display, use a video driver with OpenGL, e.g. SDL_VIDEODRIVER=offscreen, not 'dummy'.)" << std::endl;
+		return 1;
+	}
+	init_GL();
+	SDL_GL_SetSwapInterval(0);
+
+	call_load_functions(); //(creates the PPU's shader program and buffers)
+
+	glm::uvec2 drawable_size;
+	{
+		int w, h;
+		SDL_GL_GetDrawableSize(window, &w, &h);
+		drawable_size = glm::uvec2(w, h);
+	}
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "mode          tiles  pals sprites  first ms   mean ms   p50 ms   p99 ms   (" << frames << " frames each)\n";
+	bench< PPU466 >("PPU466", frames, drawable_size);
+	bench< PPU< 1024, 16, 256 > >("in-between", frames, drawable_size);
+	bench< PPUExtended >("PPUExtended", frames, drawable_size);
+
+	SDL_GL_DeleteContext(context);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+
+	return 0;
+}
@@ -0,0 +1,65 @@
+#include "benchmark.hpp"
+
+#include "FrameStats.hpp"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+void benchmark_events(uint32_t frame, std::vector< SDL_Event > *events) {
+	//one lap of the script: hold each key for a while, then rest:
+	struct Hold {
+		SDL_Keycode key;
+		uint32_t begin, end; //frames within the lap
+	};
+	static const Hold Lap[] = {
+		{SDLK_RIGHT, 0, 60},
+		{SDLK_UP, 60, 90},
+		{SDLK_LEFT, 90, 150},
+		{SDLK_DOWN, 150, 180},
+		{SDLK_RIGHT, 200, 215}, {SDLK_UP, 205, 220}, //(overlapping presses)
+	};
+	constexpr uint32_t LapLength = 240;
+	constexpr uint32_t ResetEvery = 4 * LapLength;
+
+	auto key = [&](uint32_t type, SDL_Keycode sym) {
+		SDL_Event evt;
+		std::memset(&evt, 0, sizeof(evt));
+		evt.type = type;
+		evt.key.type = type;
+		evt.key.state = (type == SDL_KEYDOWN ? SDL_PRESSED : SDL_RELEASED);
+		evt.key.keysym.sym = sym;
+		events->emplace_back(evt);
+	};
+
+	uint32_t at = frame % LapLength;
+	for (Hold const &hold : Lap) {
+		if (at == hold.begin) key(SDL_KEYDOWN, hold.key);
+		if (at == hold.end) key(SDL_KEYUP, hold.key);
+	}
+	if (frame % ResetEvery == ResetEvery - 1) {
+		key(SDL_KEYDOWN, SDLK_r);
+		key(SDL_KEYUP, SDLK_r);
+	}
+}
+
+void benchmark_report(uint32_t frames, double seconds) {
+	FrameStats const &stats = frame_stats();
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "Benchmark: " << frames << " frames in " << seconds << " s = " << std::setprecision(1) << (frames / seconds) << " frames per second.\n";
+	std::cout << std::setprecision(3);
+	std::cout << "  stage        mean ms    p50 ms    p99 ms    max ms   share\n";
+	struct Stage {
+		char const *name;
+		FrameHistogram const &histogram;
+	};
+	double frame_mean = stats.frame.mean_ms();
+	for (Stage const &stage : { Stage{"frame", stats.frame}, Stage{"update", stats.update}, Stage{"draw", stats.draw}, Stage{"swap", stats.swap} }) {
+		FrameHistogram const &h = stage.histogram;
+		std::cout << "  " << std::left << std::setw(8) << stage.name << std::right
+			<< std::setw(12) << h.mean_ms() << std::setw(10) << h.percentile_ms(0.50) << std::setw(10) << h.percentile_ms(0.99)
+			<< std::setw(10) << h.max_ms() << std::setw(7) << std::setprecision(0) << (frame_mean > 0.0 ? 100.0 * h.mean_ms() / frame_mean : 0.0) << "%\n"
+			<< std::setprecision(3);
+	}
+	std::cout << "  (the rest of each frame is event handling and loop overhead)" << std::endl;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+/*
+ * benchmark -- run the game uncapped on scripted input and report how fast it goes:
+ *
+ *   dist/game --benchmark 2000 [--level 2]
+ *
+ * Once startup is over, plays N frames with vsync off, a fixed 1/60 s update step,
+ * and the input from benchmark_events(); then prints frames per second and a per-stage breakdown
+ * (from frame_stats()), and writes the frames' PROFILE_SCOPE timings to 'benchmark-trace.json'.
+ *
+ * The window is hidden, so this also runs without a display, e.g.:
+ *   SDL_VIDEODRIVER=offscreen LIBGL_ALWAYS_SOFTWARE=1 dist/game --benchmark 500
+ * (the "dummy" video driver has no OpenGL, so the "offscreen" driver [SDL 2.0.12+] plus a software GL like Mesa's llvmpipe is needed)
+ *
+ */
+
+#include <SDL.h>
+
+#include <cstdint>
+#include <vector>
+
+//the scripted input for benchmark frame 'frame' (events are appended to 'events'):
+// (walks the player around in a loop and resets the level now and then; the same every run)
+void benchmark_events(uint32_t frame, std::vector< SDL_Event > *events);
+
+//print results for 'frames' frames that took 'seconds' in total:
+void benchmark_report(uint32_t frames, double seconds);
@@ -0,0 +1,102 @@
+#include "chrome_trace.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+namespace {
+	std::mutex &thread_mutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+	std::map< uint32_t, std::string > &thread_names() { //<-- guarded by thread_mutex()
+		static std::map< uint32_t, std::string > names;
+		return names;
+	}
+
+	//JSON string with quotes:
+	std::string quote(std::string const &str) {
+		std::string ret = "\"";
+		for (char c : str) {
+			if (c == '"' || c == '\\') {
+				ret += '\\';
+				ret += c;
+			} else if (uint8_t(c) < 0x20) {
+				char buffer[8];
+				snprintf(buffer, sizeof(buffer), "\\u%04x", uint32_t(c));
+				ret += buffer;
+			} else {
+				ret += c;
+			}
+		}
+		ret += '"';
+		return ret;
+	}
+}
+
+TraceClock::time_point trace_epoch() {
+	static TraceClock::time_point epoch = TraceClock::now();
+	return epoch;
+}
+
+double trace_time(TraceClock::time_point const &time) {
+	return std::chrono::duration< double, std::micro >(time - trace_epoch()).count();
+}
+
+uint32_t trace_thread() {
+	static std::atomic< uint32_t > next_thread{0};
+	static thread_local uint32_t thread = next_thread++;
+	return thread;
+}
+
+void trace_thread_name(std::string const &name) {
+	uint32_t thread = trace_thread();
+	std::lock_guard< std::mutex > lock(thread_mutex());
+	thread_names()[thread] = name;
+}
+
+uint32_t trace_track(std::string const &name) {
+	static std::atomic< uint32_t > next_track{1000}; //(well clear of thread numbers)
+	uint32_t track = next_track++;
+	std::lock_guard< std::mutex > lock(thread_mutex());
+	thread_names()[track] = name;
+	return track;
+}
+
+bool write_chrome_trace(std::string const &filename, std::vector< TraceEvent > const &events) {
+	std::ofstream out(filename, std::ios::binary);
+	if (!out) {
+		std::cerr << "WARNING: couldn't write trace to '" << filename << "'." << std::endl;
+		return false;
+	}
+	out.precision(3);
+	out << std::fixed;
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	{
+		std::lock_guard< std::mutex > lock(thread_mutex());
+		for (auto const &tn : thread_names()) {
+			out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tn.first
+				<< ",\"args\":{\"name\":" << quote(tn.second) << "}}";
+			first = false;
+		}
+	}
+	for (auto const &event : events) {
+		out << (first ? "" : ",\n") << "{\"name\":" << quote(event.name) << ",\"cat\":" << quote(event.category)
+			<< ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << event.start << ",\"dur\":" << event.duration;
+		if (!event.args.empty()) {
+			out << ",\"args\":{";
+			for (uint32_t a = 0; a < event.args.size(); ++a) {
+				out << (a ? "," : "") << quote(event.args[a].first) << ":" << event.args[a].second;
+			}
+			out << "}";
+		}
+		out << "}";
+		first = false;
+	}
+	out << "\n]}\n";
+	return bool(out);
+}
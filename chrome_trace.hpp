@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+ * Helpers for writing Chrome "trace event" JSON files.
+ * (open with chrome://tracing or https://ui.perfetto.dev)
+ *
+ * Times are microseconds since trace_epoch(), which is fixed the first time anything asks for it
+ * (so call trace_epoch() early in main() to measure from program start).
+ *
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef std::chrono::steady_clock TraceClock;
+
+//a complete ("ph":"X") event:
+struct TraceEvent {
+	std::string name;
+	std::string category;
+	double start = 0.0; //microseconds since trace_epoch()
+	double duration = 0.0; //microseconds
+	uint32_t thread = 0; //as returned by trace_thread()
+	std::vector< std::pair< std::string, double > > args; //shown when the event is selected
+};
+
+TraceClock::time_point trace_epoch();
+
+//microseconds from trace_epoch() to 'time':
+double trace_time(TraceClock::time_point const &time);
+
+//small, stable number for the calling thread (the first thread to ask is 0):
+uint32_t trace_thread();
+
+//give the calling thread a name in traces:
+void trace_thread_name(std::string const &name);
+
+//a new track (a number that is not any thread's) with a name, for timelines that aren't CPU threads (e.g., GPU time):
+uint32_t trace_track(std::string const &name);
+
+//write events (and thread names) to a file; returns false (after printing a warning) if it can't be written:
+bool write_chrome_trace(std::string const &filename, std::vector< TraceEvent > const &events);
@@ -0,0 +1,129 @@
+#include "crc32c.hpp"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	#define CRC32C_X86
+	#include <nmmintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#endif
+#elif defined(__ARM_FEATURE_CRC32)
+	#define CRC32C_ARM
+	#include <arm_acle.h>
+#endif
+
+namespace {
+	//software version ("slicing by 8"):
+	struct Tables {
+		Tables() {
+			for (uint32_t i = 0; i < 256; ++i) {
+				uint32_t crc = i;
+				for (uint32_t b = 0; b < 8; ++b) {
+					crc = (crc >> 1) ^ (0x82f63b78U & (0U - (crc & 1U)));
+				}
+				table[0][i] = crc;
+			}
+			for (uint32_t i = 0; i < 256; ++i) {
+				for (uint32_t t = 1; t < 8; ++t) {
+					table[t][i] = (table[t-1][i] >> 8) ^ table[0][table[t-1][i] & 0xff];
+				}
+			}
+		}
+		std::array< std::array< uint32_t, 256 >, 8 > table;
+	};
+
+	uint32_t crc32c_software(uint8_t const *at, size_t size, uint32_t crc) {
+		static Tables const tables;
+		auto const &t = tables.table;
+		while (size >= 8) {
+			uint32_t lo, hi;
+			std::memcpy(&lo, at, 4);
+			std::memcpy(&hi, at + 4, 4);
+			lo ^= crc; //(assumes a little-endian machine, as the chunk format already does)
+			crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+			    ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+			at += 8;
+			size -= 8;
+		}
+		while (size > 0) {
+			crc = (crc >> 8) ^ t[0][(crc ^ *at) & 0xff];
+			++at;
+			--size;
+		}
+		return crc;
+	}
+
+	#if defined(CRC32C_X86)
+	#if defined(__GNUC__)
+	__attribute__((target("sse4.2")))
+	#endif
+	uint32_t crc32c_hardware(uint8_t const *at, size_t size, uint32_t crc) {
+		#if defined(__x86_64__) || defined(_M_X64)
+		uint64_t crc64 = crc;
+		while (size >= 8) {
+			uint64_t value;
+			std::memcpy(&value, at, 8);
+			crc64 = _mm_crc32_u64(crc64, value);
+			at += 8;
+			size -= 8;
+		}
+		crc = uint32_t(crc64);
+		#endif
+		while (size >= 4) {
+			uint32_t value;
+			std::memcpy(&value, at, 4);
+			crc = _mm_crc32_u32(crc, value);
+			at += 4;
+			size -= 4;
+		}
+		while (size > 0) {
+			crc = _mm_crc32_u8(crc, *at);
+			++at;
+			--size;
+		}
+		return crc;
+	}
+
+	bool have_hardware() {
+		#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 20)) != 0; //SSE4.2
+		#else
+		return __builtin_cpu_supports("sse4.2");
+		#endif
+	}
+	#elif defined(CRC32C_ARM)
+	uint32_t crc32c_hardware(uint8_t const *at, size_t size, uint32_t crc) {
+		while (size >= 8) {
+			uint64_t value;
+			std::memcpy(&value, at, 8);
+			crc = __crc32cd(crc, value);
+			at += 8;
+			size -= 8;
+		}
+		while (size > 0) {
+			crc = __crc32cb(crc, *at);
+			++at;
+			--size;
+		}
+		return crc;
+	}
+
+	bool have_hardware() {
+		return true; //(compiler was told the target has CRC32 instructions)
+	}
+	#endif
+}
+
+uint32_t crc32c(void const *data, size_t size, uint32_t crc) {
+	uint8_t const *at = reinterpret_cast< uint8_t const * >(data);
+	crc = ~crc;
+	#if defined(CRC32C_X86) || defined(CRC32C_ARM)
+	static bool const hardware = have_hardware();
+	if (hardware) return ~crc32c_hardware(at, size, crc);
+	#endif
+	return ~crc32c_software(at, size, crc);
+}
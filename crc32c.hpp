@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//CRC-32C (Castagnoli) checksum of 'size' bytes at 'data':
+// uses the SSE4.2 / ARMv8 CRC32 instructions where available, otherwise a table-driven version.
+// pass a previous result as 'crc' to continue a checksum across several buffers.
+uint32_t crc32c(void const *data, size_t size, uint32_t crc = 0);
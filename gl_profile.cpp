@@ -0,0 +1,62 @@
+#include "gl_profile.hpp"
+
+#include "GL.hpp"
+
+#include <cassert>
+#include <vector>
+
+namespace {
+	struct Query {
+		GLuint id = 0;
+		char const *name = nullptr;
+		TraceClock::rep start = 0; //CPU time when the query began
+		bool pending = false; //waiting for a result
+	};
+	std::vector< Query > queries; //(GL thread only)
+	std::vector< uint32_t > free_queries; //indices of queries not in use
+	bool in_scope = false;
+
+	ProfileRing &gpu_ring() {
+		static ProfileRing &ring = profile_track_ring("GPU");
+		return ring;
+	}
+}
+
+GLProfileScope::GLProfileScope(char const *name) {
+	assert(!in_scope && "GL_PROFILE_SCOPEs can't nest");
+	in_scope = true;
+	if (free_queries.empty()) {
+		free_queries.emplace_back(uint32_t(queries.size()));
+		queries.emplace_back();
+		glGenQueries(1, &queries.back().id);
+	}
+	query = free_queries.back();
+	free_queries.pop_back();
+
+	Query &q = queries[query];
+	q.name = name;
+	q.start = TraceClock::now().time_since_epoch().count();
+	q.pending = true;
+	glBeginQuery(GL_TIME_ELAPSED, q.id);
+}
+
+GLProfileScope::~GLProfileScope() {
+	glEndQuery(GL_TIME_ELAPSED);
+	in_scope = false;
+}
+
+void gl_profile_collect() {
+	for (uint32_t i = 0; i < queries.size(); ++i) {
+		Query &q = queries[i];
+		if (!q.pending) continue;
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(q.id, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) continue;
+		GLuint64 elapsed = 0; //nanoseconds
+		glGetQueryObjectui64v(q.id, GL_QUERY_RESULT, &elapsed);
+		TraceClock::rep ticks = std::chrono::duration_cast< TraceClock::duration >(std::chrono::nanoseconds(elapsed)).count();
+		gpu_ring().record(q.name, q.start, q.start + ticks);
+		q.pending = false;
+		free_queries.emplace_back(i);
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+/*
+ * GPU timing to go with profile.hpp:
+ *
+ * GL_PROFILE_SCOPE("draw call") times the GL commands issued until the end of the enclosing scope
+ * with a GL_TIME_ELAPSED query. Results arrive a frame or two later, when gl_profile_collect()
+ * (called once per frame) finds them; they are recorded on a "GPU" track of the profile,
+ * starting at the CPU time the commands were issued, so the two timelines can be compared.
+ *
+ * GL_TIME_ELAPSED queries can't overlap, so GL_PROFILE_SCOPEs must not nest.
+ * Only use from the thread with the OpenGL context.
+ *
+ */
+
+#include "profile.hpp"
+
+#if PROFILE_ENABLED
+#define GL_PROFILE_SCOPE(name) GLProfileScope PROFILE_CONCAT(gl_profile_scope_, __LINE__)(name)
+#else
+#define GL_PROFILE_SCOPE(name) (void)0
+#endif
+
+struct GLProfileScope {
+	explicit GLProfileScope(char const *name);
+	~GLProfileScope();
+	uint32_t query; //index into the query pool
+};
+
+//record results of finished queries (call once per frame):
+void gl_profile_collect();
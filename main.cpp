@@ -4,6 +4,18 @@
 //The 'PlayMode' mode plays the game:
 #include "PlayMode.hpp"
 
+//For startup timing:
+#include "startup_profile.hpp"
+
+//For frame timing:
+#include "profile.hpp"
+#include "gl_profile.hpp"
+#include "FrameStats.hpp"
+
+//For --benchmark:
+#include "benchmark.hpp"
+#include "data_path.hpp"
+
 //For asset loading:
 #include "Load.hpp"
 
@@ -22,6 +34,8 @@
 #include <stdexcept>
 #include <memory>
 #include <algorithm>
+#include <string>
+#include <cstdlib>
 
 int main(int argc, char **argv) {
 #ifdef _WIN32
@@ -29,11 +43,54 @@ int main(int argc, char **argv) {
 	try {
 #endif
 
+	//------------  command line ------------
+
+	uint32_t benchmark_frames = 0; //if nonzero, run this many benchmark frames and quit (see benchmark.hpp)
+	int32_t start_level = -1; //if non-negative, start on this level
+	std::string record_to; //if set, save the run's input here (see InputReplay.hpp)
+	std::string replay_from; //if set, play back input from here
+	bool no_draw = false; //skip drawing (so replays run as fast as they can)
+	bool watch = false; //rebuild + reload tilebin when the art changes (see AssetWatcher.hpp)
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--benchmark" && argi + 1 < argc) {
+			benchmark_frames = uint32_t(std::max(1, std::atoi(argv[++argi])));
+		} else if (arg == "--level" && argi + 1 < argc) {
+			start_level = std::max(0, std::atoi(argv[++argi]));
+		} else if (arg == "--record" && argi + 1 < argc) {
+			record_to = argv[++argi];
+		} else if (arg == "--replay" && argi + 1 < argc) {
+			replay_from = argv[++argi];
+		} else if (arg == "--no-draw") {
+			no_draw = true;
+		} else if (arg == "--watch") {
+			watch = true;
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--benchmark <frames>] [--level <index>] [--record <file>] [--replay <file> [--no-draw]] [--watch]" << std::endl;
+			return 1;
+		}
+	}
+	if (no_draw && replay_from.empty()) {
+		std::cerr << "--no-draw only makes sense with --replay." << std::endl;
+		return 1;
+	}
+	if (watch && (benchmark_frames || !record_to.empty() || !replay_from.empty())) {
+		std::cerr << "--watch can't be used with --benchmark, --record, or --replay (reloaded assets would change the run)." << std::endl;
+		return 1;
+	}
+
 	//------------  initialization ------------
 
+	//time everything from here until the game is ready (see startup_profile.hpp):
+	trace_epoch();
+	trace_thread_name("main");
+	startup_phase("SDL_Init");
+
 	//Initialize SDL library:
 	SDL_Init(SDL_INIT_VIDEO);
 
+	startup_phase("create window");
+
 	//Ask for an OpenGL context version 3.3, core profile, enable debug:
 	SDL_GL_ResetAttributes();
 	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
@@ -56,6 +113,7 @@ int main(int argc, char **argv) {
 		SDL_WINDOW_OPENGL
 		| SDL_WINDOW_RESIZABLE //uncomment to allow resizing
 		| SDL_WINDOW_ALLOW_HIGHDPI //uncomment for full resolution on high-DPI screens
+		| (benchmark_frames || no_draw ? SDL_WINDOW_HIDDEN : 0) //(benchmarks and undrawn replays don't need to be seen)
 	);
 
 	//prevent exceedingly tiny windows when resizing:
@@ -66,20 +124,32 @@ int main(int argc, char **argv) {
 		return 1;
 	}
 
+	startup_phase("create OpenGL context");
+
 	//Create OpenGL context:
 	SDL_GLContext context = SDL_GL_CreateContext(window);
 
 	if (!context) {
 		SDL_DestroyWindow(window);
 		std::cerr << "Error creating OpenGL context: " << SDL_GetError() << std::endl;
+		if (benchmark_frames) {
+			std::cerr << "(Benchmarks without a display need a video driver with OpenGL, e.g. SDL_VIDEODRIVER=offscreen, not 'dummy'.)" << std::endl;
+		}
 		return 1;
 	}
 
+	startup_phase("init_GL");
+
 	//On windows, load OpenGL entrypoints: (does nothing on other platforms)
 	init_GL();
 
 	//Set VSYNC + Late Swap (prevents crazy FPS):
-	if (SDL_GL_SetSwapInterval(-1) != 0) {
+	if (benchmark_frames) {
+		//...except when benchmarking, where crazy FPS is the point:
+		if (SDL_GL_SetSwapInterval(0) != 0) {
+			std::cerr << "NOTE: couldn't turn off vsync (" << SDL_GetError() << "); benchmark will be capped at the refresh rate." << std::endl;
+		}
+	} else if (SDL_GL_SetSwapInterval(-1) != 0) {
 		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
 		if (SDL_GL_SetSwapInterval(1) != 0) {
 			std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
@@ -90,10 +160,27 @@ int main(int argc, char **argv) {
 	//SDL_ShowCursor(SDL_DISABLE);
 
 	//------------ load assets --------------
+	startup_phase("call_load_functions");
 	call_load_functions();
 
 	//------------ create game mode + make current --------------
-	Mode::set_current(std::make_shared< PlayMode >());
+	startup_phase("PlayMode()");
+	{
+		std::shared_ptr< PlayMode > play = std::make_shared< PlayMode >();
+		if (start_level >= 0) play->level_index = start_level;
+		if (record_to != "") play->record_replay(record_to);
+		if (replay_from != "") play->play_replay(replay_from);
+		if (watch) play->watch_assets();
+		Mode::set_current(play);
+	}
+
+	startup_phase("first frame");
+	bool startup_reported = false;
+
+	//benchmark frames are counted once startup is over:
+	uint32_t benchmark_frame = 0;
+	std::chrono::high_resolution_clock::time_point benchmark_start;
+	std::vector< SDL_Event > benchmark_input;
 
 	//------------ main loop ------------
 
@@ -114,10 +201,13 @@ int main(int argc, char **argv) {
 
 	//This will loop until the current mode is set to null:
 	while (Mode::current) {
+		PROFILE_SCOPE("frame");
+
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
 		{ //(1) process any events that are pending
+			PROFILE_SCOPE("events");
 			static SDL_Event evt;
 			while (SDL_PollEvent(&evt) == 1) {
 				//handle resizing:
@@ -130,6 +220,9 @@ int main(int argc, char **argv) {
 				} else if (evt.type == SDL_QUIT) {
 					Mode::set_current(nullptr);
 					break;
+				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F9) {
+					// --- dump recent frame timings ---
+					profile_dump(data_path("frame-trace.json"));
 				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_PRINTSCREEN) {
 					// --- screenshot key ---
 					std::string filename = "screenshot.png";
@@ -147,6 +240,15 @@ int main(int argc, char **argv) {
 				}
 			}
 			if (!Mode::current) break;
+
+			//when benchmarking, the input is scripted:
+			if (benchmark_frames && startup_reported) {
+				benchmark_input.clear();
+				benchmark_events(benchmark_frame, &benchmark_input);
+				for (SDL_Event const &input : benchmark_input) {
+					Mode::current->handle_event(input, window_size);
+				}
+			}
 		}
 
 		{ //(2) call the current mode's "update" function to deal with elapsed time:
@@ -155,26 +257,79 @@ int main(int argc, char **argv) {
 			float elapsed = std::chrono::duration< float >(current_time - previous_time).count();
 			previous_time = current_time;
 
+			//(the first frame has no previous frame to measure from)
+			static bool first_frame = true;
+			if (!first_frame) frame_stats().frame.add(elapsed);
+			first_frame = false;
+
 			//if frames are taking a very long time to process,
 			//lag to avoid spiral of death:
 			elapsed = std::min(0.1f, elapsed);
 
+			//benchmarks step at a fixed rate so that every run simulates the same thing:
+			if (benchmark_frames) elapsed = 1.0f / 60.0f;
+			//...and undrawn replays take one simulation step per pass, as fast as they can:
+			if (no_draw) elapsed = Simulation::Tick;
+
 			Mode::current->update(elapsed);
+			auto after_update = std::chrono::high_resolution_clock::now();
+			frame_stats().update.add(std::chrono::duration< double >(after_update - current_time).count());
 			if (!Mode::current) break;
+
+			//undrawn replays quit once the recording runs out:
+			if (no_draw) {
+				std::shared_ptr< PlayMode > play = std::dynamic_pointer_cast< PlayMode >(Mode::current);
+				if (play && play->replay_finished()) {
+					Mode::set_current(nullptr);
+					break;
+				}
+			}
 		}
 
-		{ //(3) call the current mode's "draw" function to produce output:
-		
+		if (!no_draw) { //(3) call the current mode's "draw" function to produce output:
+			auto before_draw = std::chrono::high_resolution_clock::now();
 			Mode::current->draw(drawable_size);
+			frame_stats().draw.add(std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - before_draw).count());
 		}
 
 		//Wait until the recently-drawn frame is shown before doing it all again:
-		SDL_GL_SwapWindow(window);
+		if (!no_draw) {
+			PROFILE_SCOPE("SDL_GL_SwapWindow");
+			auto before_swap = std::chrono::high_resolution_clock::now();
+			SDL_GL_SwapWindow(window);
+			frame_stats().swap.add(std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - before_swap).count());
+		}
+		gl_profile_collect();
+
+		//once the first frame is out and background loading is done, report on startup:
+		if (!startup_reported) {
+			startup_phase("");
+			if (startup_pending() == 0) {
+				startup_report();
+				startup_reported = true;
+				if (benchmark_frames) {
+					//(loading frames aren't part of the benchmark)
+					frame_stats().clear();
+					benchmark_start = std::chrono::high_resolution_clock::now();
+				}
+			}
+		} else if (benchmark_frames) {
+			benchmark_frame += 1;
+			if (benchmark_frame == benchmark_frames) {
+				glFinish(); //(make sure the GPU has caught up before stopping the clock)
+				double seconds = std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - benchmark_start).count();
+				benchmark_report(benchmark_frames, seconds);
+				profile_dump(data_path("benchmark-trace.json"));
+				Mode::set_current(nullptr);
+			}
+		}
 	}
 
 
 	//------------  teardown ------------
 
+	frame_stats().write_csv(data_path(""));
+
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
@@ -0,0 +1,197 @@
+#include "pack_palettes.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <cassert>
+
+namespace {
+	//colors are handled as packed 32-bit keys so sets can be sorted and merged cheaply:
+	// (fully transparent -- (0,0,0,0) -- is key 0)
+	typedef std::vector< uint32_t > Keys;
+
+	constexpr uint32_t PaletteSize = 4;
+
+	//inputs with at most this many distinct color sets are solved exactly:
+	constexpr uint32_t ExhaustiveLimit = 16;
+	//...but the exact search gives up (keeping its best answer so far) after this many steps:
+	constexpr uint32_t SearchBudget = 1000000;
+
+	uint32_t to_key(glm::u8vec4 const &color) {
+		return uint32_t(color.r) | (uint32_t(color.g) << 8) | (uint32_t(color.b) << 16) | (uint32_t(color.a) << 24);
+	}
+
+	glm::u8vec4 from_key(uint32_t key) {
+		return glm::u8vec4(key & 0xff, (key >> 8) & 0xff, (key >> 16) & 0xff, (key >> 24) & 0xff);
+	}
+
+	std::string describe(Keys const &keys) {
+		std::ostringstream str;
+		for (auto key : keys) {
+			glm::u8vec4 c = from_key(key);
+			str << " (" << int(c.r) << ", " << int(c.g) << ", " << int(c.b) << ", " << int(c.a) << ")";
+		}
+		return str.str();
+	}
+
+	Keys merge(Keys const &a, Keys const &b) {
+		Keys ret;
+		ret.reserve(a.size() + b.size());
+		std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(ret));
+		return ret;
+	}
+
+	bool contains(Keys const &palette, Keys const &set) {
+		return std::includes(palette.begin(), palette.end(), set.begin(), set.end());
+	}
+
+	//heuristic: place each set (largest first) in the palette it grows the least, or start a new palette:
+	std::vector< Keys > best_fit_decreasing(std::vector< Keys > const &items) {
+		std::vector< Keys > bins;
+		for (auto const &item : items) {
+			uint32_t best = uint32_t(bins.size());
+			size_t best_growth = PaletteSize + 1;
+			for (uint32_t b = 0; b < bins.size(); ++b) {
+				Keys combined = merge(bins[b], item);
+				if (combined.size() > PaletteSize) continue;
+				size_t growth = combined.size() - bins[b].size();
+				if (growth < best_growth) {
+					best = b;
+					best_growth = growth;
+				}
+			}
+			if (best == bins.size()) {
+				bins.emplace_back(item);
+			} else {
+				bins[best] = merge(bins[best], item);
+			}
+		}
+		return bins;
+	}
+
+	//exact: branch-and-bound over "put this set in an existing palette or a new one":
+	struct Search {
+		Search(std::vector< Keys > const &items_, std::vector< Keys > const &initial) : items(items_), best(initial) { }
+		std::vector< Keys > const &items;
+		std::vector< Keys > best;
+		std::vector< Keys > bins;
+		uint32_t steps = 0;
+
+		void recurse(uint32_t i) {
+			if (steps++ > SearchBudget) return;
+			if (bins.size() >= best.size()) return; //can't beat current best
+			if (i == items.size()) {
+				best = bins;
+				return;
+			}
+			for (auto &bin : bins) {
+				Keys combined = merge(bin, items[i]);
+				if (combined.size() > PaletteSize) continue;
+				std::swap(bin, combined);
+				recurse(i + 1);
+				std::swap(bin, combined);
+			}
+			bins.emplace_back(items[i]);
+			recurse(i + 1);
+			bins.pop_back();
+		}
+	};
+}
+
+void pack_palettes(
+	std::vector< ColorSet > const &sets,
+	std::vector< std::string > const &labels,
+	uint32_t max_palettes,
+	std::vector< PPU466::Palette > *palettes_,
+	std::vector< uint32_t > *assignment_
+) {
+	assert(palettes_);
+	assert(assignment_);
+	assert(labels.size() == sets.size());
+	auto &palettes = *palettes_;
+	auto &assignment = *assignment_;
+
+	//convert to sorted key lists, rejecting tiles that can't fit in any palette:
+	std::vector< Keys > keys;
+	keys.reserve(sets.size());
+	Keys all_colors;
+	for (uint32_t i = 0; i < sets.size(); ++i) {
+		Keys k;
+		for (auto const &color : sets[i]) {
+			k.emplace_back(to_key(color));
+		}
+		std::sort(k.begin(), k.end());
+		k.erase(std::unique(k.begin(), k.end()), k.end());
+		if (k.size() > PaletteSize) {
+			throw std::runtime_error("Tile '" + labels[i] + "' uses " + std::to_string(k.size()) + " colors (transparent counts as one):" + describe(k)
+				+ "; but a palette only has " + std::to_string(PaletteSize) + " entries.");
+		}
+		all_colors.insert(all_colors.end(), k.begin(), k.end());
+		keys.emplace_back(std::move(k));
+	}
+	std::sort(all_colors.begin(), all_colors.end());
+	all_colors.erase(std::unique(all_colors.begin(), all_colors.end()), all_colors.end());
+
+	//only sets that aren't contained in another set need to be packed:
+	std::vector< Keys > items = keys;
+	std::sort(items.begin(), items.end(), [](Keys const &a, Keys const &b){
+		if (a.size() != b.size()) return a.size() > b.size();
+		return a < b;
+	});
+	items.erase(std::unique(items.begin(), items.end()), items.end());
+	{
+		std::vector< Keys > maximal;
+		for (auto const &item : items) {
+			bool covered = false;
+			for (auto const &m : maximal) {
+				if (contains(m, item)) {
+					covered = true;
+					break;
+				}
+			}
+			if (!covered) maximal.emplace_back(item);
+		}
+		items = std::move(maximal);
+	}
+
+	std::vector< Keys > bins = best_fit_decreasing(items);
+	size_t lower_bound = (all_colors.size() + PaletteSize - 1) / PaletteSize;
+	if (items.size() <= ExhaustiveLimit && bins.size() > lower_bound) {
+		Search search(items, bins);
+		search.recurse(0);
+		bins = std::move(search.best);
+	}
+
+	assignment.assign(keys.size(), 0);
+	for (uint32_t i = 0; i < keys.size(); ++i) {
+		uint32_t b = 0;
+		while (b < bins.size() && !contains(bins[b], keys[i])) ++b;
+		assert(b < bins.size() && "every set was packed");
+		assignment[i] = b;
+	}
+
+	if (bins.size() > max_palettes) {
+		std::ostringstream message;
+		message << "Could not fit tile colors into " << max_palettes << " palettes; the best packing found uses " << bins.size()
+			<< " (" << all_colors.size() << " distinct colors in " << items.size() << " incompatible color sets).";
+		for (uint32_t b = 0; b < bins.size(); ++b) {
+			message << "\n  palette " << b << ":" << describe(bins[b]) << " used by";
+			for (uint32_t i = 0; i < keys.size(); ++i) {
+				if (assignment[i] == b) message << " '" << labels[i] << "'";
+			}
+		}
+		throw std::runtime_error(message.str());
+	}
+
+	palettes.clear();
+	for (auto const &bin : bins) {
+		PPU466::Palette palette;
+		palette.fill(glm::u8vec4(0x00, 0x00, 0x00, 0x00));
+		//transparent (key 0) sorts first, so ends up in entry 0 when present:
+		for (uint32_t c = 0; c < bin.size(); ++c) {
+			palette[c] = from_key(bin[c]);
+		}
+		palettes.emplace_back(palette);
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+/*
+ * pack_palettes -- choose a small set of 4-color palettes that covers every tile.
+ *
+ * Each tile uses some set of (at most four) colors; a palette "covers" a tile if
+ * it contains all of the tile's colors. Finding the fewest palettes is a bin-packing
+ * style problem (bins of four colors, items that may share colors), so:
+ *  - small inputs are solved exactly with a branch-and-bound search, and
+ *  - large inputs use a best-fit-decreasing heuristic (also used as the search's initial bound).
+ *
+ */
+
+#include "PPU466.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+//A ColorSet is the list of colors used by a tile:
+// all fully-transparent pixels should be reported as the single color (0,0,0,0)
+typedef std::vector< glm::u8vec4 > ColorSet;
+
+//Pack the color sets into at most 'max_palettes' palettes:
+// - 'palettes' gets the palettes (unused entries are (0,0,0,0); transparent, if used, is entry 0)
+// - 'assignment' gets, for each color set, the index of a palette that contains all of its colors
+// - 'labels' (same size as 'sets') are used to name the offending tiles in error messages
+//Throws std::runtime_error with a diagnostic if a tile has too many colors or the sets do not fit.
+void pack_palettes(
+	std::vector< ColorSet > const &sets,
+	std::vector< std::string > const &labels,
+	uint32_t max_palettes,
+	std::vector< PPU466::Palette > *palettes,
+	std::vector< uint32_t > *assignment
+);
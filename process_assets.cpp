@@ -4,9 +4,12 @@
  * https://github.com/xinyis991105/15-466-f20-base1/blob/master/asset_generation.cpp, 
  * https://github.com/15-466/15-466-f19-base1/blob/master/pack-sprites.cpp
  * My asset processing was inspired by the method used in the above examples.
- * I will load the sprite pngs, divide them into 8x8 blocks, get the palette, and format the tile, for each sprite.
+ * Sprites come from sprite sheets listed in tiles/sprites.txt; each sheet is decoded once and sliced into sprites.
+ * sprites.txt also lists animation clips (see Animation.hpp), which are stored alongside the tiles.
+ * I will divide each sprite into 8x8 blocks, and get the colors used by each tile.
+ * Palettes are then chosen for all tiles at once (see pack_palettes.hpp) and each tile is formatted using its palette.
  * I have designed the sprites to have no more than 4 colors, and the image dimensions are divisible by 8.
- * The levels will be processed from a 32x30 png labeled as a level. Different colored pixels represent different tiles.
+ * The levels will be processed from pngs (any size, one pixel per 16x16 cell) labeled as levels. Different colored pixels represent different tiles.
  * This makes it easier to design a level.
 */
 
@@ -16,179 +19,305 @@
 #include "PPU466.hpp"
 #include "data_path.hpp"
 #include "Level.hpp"
+#include "Simulation.hpp"
+#include "pack_palettes.hpp"
 
 #include <glm/glm.hpp>
 
 #include <vector>
+#include <array>
+#include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <cstring>
+#include <cstdio>
+#include <cmath>
+
+//a sprite sheet from the slicing description (tiles/sprites.txt):
+struct SpriteSheet {
+    std::string file;
+    glm::uvec2 sprite_size = glm::uvec2(16, 16);
+    std::vector<glm::uvec2> cells; //(column, row) of each sprite to use, counted from the top-left; empty means "all of them"
+};
+
+//an animation clip from the slicing description:
+struct ClipLine {
+    std::string name;
+    std::vector<std::pair<uint32_t, float>> frames; //(first tile, seconds)
+    std::string where; //file:line, for error messages
+};
+
+//reads the slicing description; lines look like:
+// <png file> <sprite width>x<sprite height> [<column>,<row> ...]
+// clip <name> <tile>:<seconds> [<tile>:<seconds> ...]
+std::vector<SpriteSheet> read_sprite_sheets(std::string const &filename, std::vector<ClipLine> *clips) {
+    std::ifstream in(filename);
+    if (!in) throw std::runtime_error("Failed to open sprite sheet description '" + filename + "'.");
+
+    std::vector<SpriteSheet> sheets;
+    std::string line;
+    uint32_t line_number = 0;
+    while (std::getline(in, line)) {
+        ++line_number;
+        if (line.find('#') != std::string::npos) line = line.substr(0, line.find('#'));
+        std::istringstream str(line);
+        SpriteSheet sheet;
+        if (!(str >> sheet.file)) continue; //blank line
+        if (sheet.file == "clip") {
+            ClipLine clip;
+            clip.where = filename + ":" + std::to_string(line_number);
+            std::pair<uint32_t, float> frame;
+            char colon = '\0';
+            if (!(str >> clip.name) || clip.name.size() >= sizeof(AnimationClip::name)) {
+                throw std::runtime_error(clip.where + ": expected a clip name (at most " + std::to_string(sizeof(AnimationClip::name) - 1) + " characters) after 'clip'.");
+            }
+            while (str >> frame.first >> colon >> frame.second) {
+                if (colon != ':' || !(frame.second > 0.0f)) throw std::runtime_error(clip.where + ": expected frames like '4:0.5' (tile:seconds).");
+                clip.frames.push_back(frame);
+            }
+            if (!str.eof() || clip.frames.empty()) throw std::runtime_error(clip.where + ": couldn't read frame list.");
+            clips->push_back(clip);
+            continue;
+        }
+        char x = '\0';
+        if (!(str >> sheet.sprite_size.x >> x >> sheet.sprite_size.y) || x != 'x'
+            || sheet.sprite_size.x == 0 || sheet.sprite_size.y == 0
+            || sheet.sprite_size.x % 8 != 0 || sheet.sprite_size.y % 8 != 0) {
+            throw std::runtime_error(filename + ":" + std::to_string(line_number) + ": expected a sprite size like '16x16' (multiples of 8) after '" + sheet.file + "'.");
+        }
+        glm::uvec2 cell;
+        char comma = '\0';
+        while (str >> cell.x >> comma >> cell.y) {
+            if (comma != ',') throw std::runtime_error(filename + ":" + std::to_string(line_number) + ": expected cells like '1,0'.");
+            sheet.cells.push_back(cell);
+        }
+        if (!str.eof()) throw std::runtime_error(filename + ":" + std::to_string(line_number) + ": couldn't read cell list.");
+        sheets.push_back(sheet);
+    }
+    return sheets;
+}
 
 int main(int argc, char** argv) {
     std::cout << "processing assets...\n";
 
-    const uint32_t num_levels = 4;
-    const uint32_t num_sprites = 11;
-    std::string tile_files[num_sprites] = { "../tiles/Cat1.png", "../tiles/Cat2.png", 
-                                            "../tiles/TopBlock.png", "../tiles/Block.png", 
-                                            "../tiles/Box1.png", "../tiles/Box2.png", "../tiles/Box3.png",
-                                            "../tiles/Ladder.png", "../tiles/Spikes1.png", "../tiles/Spikes2.png", "../tiles/Spikes3.png"};
+    std::string tile_folder = "../tiles/";
     std::string level_files = "../levels/";
-    //png size
-    glm::uvec2 size = glm::uvec2(16, 16);
 
     std::vector<PPU466::Palette> palette_table;
     std::vector<PPU466::Tile> tile_table;
     std::vector<int> tile_to_palette_map;
     std::vector<Level> levels;
-    
 
-    //loop through all sprite files
-    for (uint32_t i = 0; i < num_sprites; ++i) {
+    //pixels of every 8x8 tile (transparent pixels are stored as (0,0,0,0)), along with the set of colors each uses:
+    std::vector<std::array<glm::u8vec4, 8 * 8>> tile_pixels;
+    std::vector<ColorSet> tile_colors;
+    std::vector<std::string> tile_labels;
+    std::vector<ClipLine> clip_lines;
 
-        std::cout << "loading " << tile_files[i] << "\n";
-        std::vector<glm::u8vec4> data;
-        load_png(data_path(tile_files[i]), &size, &data, LowerLeftOrigin);
+    try {
+        //each sheet is decoded once and then sliced into sprites, which are split into 8x8 tiles:
+        for (SpriteSheet const &sheet : read_sprite_sheets(data_path(tile_folder + "sprites.txt"), &clip_lines)) {
 
-        assert(size.x * size.y <= data.size());
+            std::cout << "loading " << tile_folder + sheet.file << "\n";
+            glm::uvec2 size;
+            std::vector<glm::u8vec4> data;
+            load_png(data_path(tile_folder + sheet.file), &size, &data, LowerLeftOrigin);
 
-        //loop through tiles
-        PPU466::Palette palette;
-        PPU466::Tile tile;
-        for (uint32_t tileY = 0; tileY < size.y; tileY+=8) {
-            for (uint32_t tileX = 0; tileX < size.x; tileX+=8) {
-
-                std::cout << "getting palette of (" << tileX << ", " << tileY << ")" << "\n";
-                //get palette of tile
-                memset(&palette, 0, sizeof(glm::u8vec4) * 4);
-                uint32_t num_colors = 0;
-                for (uint8_t pixelY = 0; pixelY < 8; ++pixelY) {
-                    for (uint8_t pixelX = 0; pixelX < 8; ++pixelX) {
-                        glm::u8vec4 curr_color = data[(tileX + pixelX) + size.x * (tileY + pixelY)];
-                        //skip blank tiles bc they may have different values
-                        if (curr_color[3] != 0xff || (curr_color[0] == 0xff && curr_color[1] == 0xff && curr_color[2] == 0xff)) continue;
-                        bool found = false;
-                        for (uint8_t col = 0; col < 4; ++col) {
-                            if (curr_color == palette[col]) {
-                                found = true;
-                                break;
-                            }
-                        }
-                        if (!found) {
-                            palette[num_colors] = curr_color;
-                            std::cout << "adding color (" << (int)curr_color[0] << ", " << (int)curr_color[1] << ", " << (int)curr_color[2] << ", " << (int)curr_color[3] << ")\n";
-                            ++num_colors;
-                        }
-                    }
-                }
+            assert(size.x * size.y <= data.size());
+            if (size.x % sheet.sprite_size.x != 0 || size.y % sheet.sprite_size.y != 0) {
+                throw std::runtime_error(sheet.file + " is " + std::to_string(size.x) + "x" + std::to_string(size.y)
+                    + ", which isn't a whole number of " + std::to_string(sheet.sprite_size.x) + "x" + std::to_string(sheet.sprite_size.y) + " sprites.");
+            }
+            glm::uvec2 grid = glm::uvec2(size.x / sheet.sprite_size.x, size.y / sheet.sprite_size.y);
 
-                std::cout << "got " << num_colors << " colors. \n";
-                assert(num_colors <= 4);
-                
-                //check if palette exists in table
-                int palette_index = -1;
-                for (uint32_t p = 0; p < palette_table.size(); ++p) {
-                    PPU466::Palette compare_palette = palette_table[p];
-                    bool all_found = true;
-                    for (uint32_t a = 0; a < num_colors; ++a) {
-                        glm::u8vec4 looking_for_color = palette[a];
-                        bool found = false;
-                        for (uint32_t b = 0; b < 4; ++b) {
-                            if (looking_for_color == compare_palette[b]) {
-                                found = true;
-                                break;
-                            }
-                        }
-                        if (!found) {
-                            all_found = false;
-                            break;
-                        }
+            std::vector<glm::uvec2> cells = sheet.cells;
+            if (cells.empty()) {
+                for (uint32_t row = 0; row < grid.y; ++row) {
+                    for (uint32_t column = 0; column < grid.x; ++column) {
+                        cells.push_back(glm::uvec2(column, row));
                     }
-                    if (all_found) {
-                        palette_index = p;
-                        break;
-                    }
-                }
-                if (palette_index == -1) {
-                    palette_index = (int)palette_table.size();
-                    palette_table.push_back(palette);
                 }
-                
-                assert(palette_index != -1);
-                tile_to_palette_map.push_back(palette_index); //since each tile gets pushed, palette is same index
-
-                //get tile information
-                palette = palette_table[palette_index];
-                std::cout << "colors: ";
-                for (int i = 0; i < 4; ++i) {
-                    std::cout << "(" << (int)palette[i][0] << ", " << (int)palette[i][1] << ", " << (int)palette[i][2] << ", " << (int)palette[i][3] << ")\n";
+            }
+
+            for (glm::uvec2 const &cell : cells) {
+                if (cell.x >= grid.x || cell.y >= grid.y) {
+                    throw std::runtime_error(sheet.file + " has no sprite at " + std::to_string(cell.x) + "," + std::to_string(cell.y)
+                        + " (it is " + std::to_string(grid.x) + "x" + std::to_string(grid.y) + " sprites).");
                 }
-                memset(&tile.bit0, 0, 8);
-                memset(&tile.bit1, 0, 8);
-                for (uint32_t pixelY = 0; pixelY < 8; ++pixelY) {
-                    for (uint32_t pixelX = 0; pixelX < 8; ++pixelX) {
-                        bool found = false;
-                        for (uint32_t p = 0; p < 4; p++) {
-                            if (data[(tileX + pixelX) + size.x * (tileY + pixelY)] == palette[p] ||
-                                (data[(tileX + pixelX) + size.x * (tileY + pixelY)][3] == palette[p][3] && palette[p][3] == 0x00)) {
-                                found = true;
-                                tile.bit0[pixelY] = tile.bit0[pixelY] | ((p & 1) << pixelX);
-                                tile.bit1[pixelY] = tile.bit1[pixelY] | (((p >> 1) & 1) << pixelX);//(((p & 2) << (pixelX)) >> 1);
+                //rows are counted from the top, but the image data starts at the bottom:
+                uint32_t spriteX = cell.x * sheet.sprite_size.x;
+                uint32_t spriteY = (grid.y - 1 - cell.y) * sheet.sprite_size.y;
+
+                //loop through tiles
+                for (uint32_t tileY = spriteY; tileY < spriteY + sheet.sprite_size.y; tileY+=8) {
+                    for (uint32_t tileX = spriteX; tileX < spriteX + sheet.sprite_size.x; tileX+=8) {
+                        std::array<glm::u8vec4, 8 * 8> pixels;
+                        ColorSet colors;
+                        for (uint8_t pixelY = 0; pixelY < 8; ++pixelY) {
+                            for (uint8_t pixelX = 0; pixelX < 8; ++pixelX) {
+                                glm::u8vec4 curr_color = data[(tileX + pixelX) + size.x * (tileY + pixelY)];
+                                //blank pixels may have different rgb values, so treat them all the same
+                                if (curr_color[3] == 0x00) curr_color = glm::u8vec4(0x00, 0x00, 0x00, 0x00);
+                                pixels[pixelX + 8 * pixelY] = curr_color;
+                                if (std::find(colors.begin(), colors.end(), curr_color) == colors.end()) {
+                                    colors.push_back(curr_color);
+                                }
                             }
                         }
-                        if (!found) {
-                            glm::u8vec4 curr_color = data[(tileX + pixelX) + size.x * (tileY + pixelY)];
-                            std::cout << "color: (" << (int)curr_color[0] << ", " << (int)curr_color[1] << ", " << (int)curr_color[2] << ", " << (int)curr_color[3] << ")\n";
-                        }
-                        assert(found);
+                        tile_pixels.push_back(pixels);
+                        tile_colors.push_back(colors);
+                        tile_labels.push_back(sheet.file + " (" + std::to_string(tileX) + ", " + std::to_string(tileY) + ")");
                     }
                 }
-                tile_table.push_back(tile);
             }
         }
+    } catch (std::runtime_error &e) {
+        std::cerr << "ERROR: " << e.what() << "\n";
+        return 1;
     }
 
-    glm::uvec2 level_size = glm::uvec2(16, 15); //based on 16x16 sprites
-    //load all level pngs
-    for (int i = 1; i <= num_levels; ++i) {
-        Level level;
-        std::vector<glm::u8vec4> data;
+    //pick palettes for all tiles at once, so that compatible color sets end up sharing palettes:
+    std::vector<uint32_t> tile_palettes;
+    try {
+        pack_palettes(tile_colors, tile_labels, uint32_t(std::tuple_size<decltype(PPU466::palette_table)>::value), &palette_table, &tile_palettes);
+    } catch (std::runtime_error &e) {
+        std::cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+
+    //get tile information
+    for (uint32_t t = 0; t < tile_pixels.size(); ++t) {
+        PPU466::Palette const &palette = palette_table[tile_palettes[t]];
+        tile_to_palette_map.push_back(int(tile_palettes[t]));
+
+        PPU466::Tile tile;
+        tile.bit0.fill(0);
+        tile.bit1.fill(0);
+        for (uint32_t pixelY = 0; pixelY < 8; ++pixelY) {
+            for (uint32_t pixelX = 0; pixelX < 8; ++pixelX) {
+                uint32_t p = uint32_t(std::find(palette.begin(), palette.end(), tile_pixels[t][pixelX + 8 * pixelY]) - palette.begin());
+                assert(p < 4 && "pack_palettes gave every tile a palette containing all of its colors");
+                tile.bit0[pixelY] = tile.bit0[pixelY] | ((p & 1) << pixelX);
+                tile.bit1[pixelY] = tile.bit1[pixelY] | (((p >> 1) & 1) << pixelX);
+            }
+        }
+        tile_table.push_back(tile);
+    }
+
+    if (tile_table.size() > std::tuple_size<decltype(PPU466::tile_table)>::value) {
+        std::cerr << "ERROR: sprite sheets produced " << tile_table.size() << " tiles, but the PPU only has room for " << std::tuple_size<decltype(PPU466::tile_table)>::value << ".\n";
+        return 1;
+    }
+
+    //animation clips (durations are stored in simulation ticks):
+    AnimationTable animations;
+    for (ClipLine const &line : clip_lines) {
+        AnimationClip clip;
+        std::memcpy(clip.name, line.name.data(), line.name.size());
+        clip.first_frame = uint16_t(animations.frames.size());
+        clip.frame_count = uint16_t(line.frames.size());
+        for (auto const &f : line.frames) {
+            if (f.first + 3 >= tile_table.size()) {
+                std::cerr << "ERROR: " << line.where << ": clip '" << line.name << "' uses tiles " << f.first << "-" << f.first + 3 << ", but there are only " << tile_table.size() << " tiles.\n";
+                return 1;
+            }
+            AnimationFrame frame;
+            frame.tile = uint16_t(f.first);
+            frame.ticks = uint16_t(std::max(1L, std::min(0xffffL, std::lround(f.second / Simulation::Tick))));
+            animations.frames.push_back(frame);
+        }
+        animations.clips.push_back(clip);
+    }
 
-        std::cout << "loading " << (level_files + std::to_string(i) + ".png") << "\n";
-        load_png(data_path(level_files + std::to_string(i) + ".png"), &level_size, &data, LowerLeftOrigin);
+    //also store the tile table already expanded into the 128x128 index image the PPU draws from,
+    // so the game can upload it as-is instead of unpacking bit planes:
+    std::vector<PPU466::TileIndices> tile_indices(1);
+    tile_indices[0].fill(0);
+    for (uint32_t t = 0; t < tile_table.size(); ++t) {
+        uint32_t ox = (t % 16) * 8;
+        uint32_t oy = (t / 16) * 8;
+        for (uint32_t y = 0; y < 8; ++y) {
+            for (uint32_t x = 0; x < 8; ++x) {
+                tile_indices[0][ox+x + 128 * (oy+y)] = ((tile_table[t].bit0[y] >> x) & 1) | ((tile_table[t].bit1[y] >> x) & 1) << 1;
+            }
+        }
+    }
+
+    //load level pngs 1.png, 2.png, ... until one is missing (one pixel per 16x16 cell; any size):
+    for (int i = 1; ; ++i) {
+        std::string level_file = level_files + std::to_string(i) + ".png";
+        if (!std::ifstream(data_path(level_file))) break;
+        std::cout << "loading " << level_file << "\n";
 
-        for (uint32_t x = 0; x < 16; ++x) {
-            for (uint32_t y = 0; y < 15; ++y) {
-                glm::u8vec4 color = data[x + y * 16];
+        glm::uvec2 size;
+        std::vector<glm::u8vec4> data;
+        load_png(data_path(level_file), &size, &data, LowerLeftOrigin);
+
+        Level level;
+        level.width = size.x;
+        level.height = size.y;
+        level.cells.assign(size.x * size.y, Level::Empty);
+        for (uint32_t y = 0; y < size.y; ++y) {
+            for (uint32_t x = 0; x < size.x; ++x) {
+                glm::u8vec4 color = data[x + y * size.x];
+                uint8_t &cell = level.cells[x + y * size.x];
                 if (color[3] == 0x00) continue;
                 if (color[0] == 0x00 && color[1] == 0x00 && color[2] == 0x00) { //black
                     level.starting_pos = glm::ivec2(x*2, y*2);
                 }
                 else if (color[0] == 0x00 && color[1] == 0xff && color[2] == 0x00) { //green
-                    level.topblocks[x][y] = true;
+                    cell = Level::TopBlock;
                 }
                 else if (color[0] == 0xff && color[1] == 0xff && color[2] == 0x00) { //yellow
-                    level.blocks[x][y] = true;
+                    cell = Level::Block;
                 }
                 else if (color[0] == 0x00 && color[1] == 0x00 && color[2] == 0xff) { //blue
-                    level.ladders[x][y] = true;
+                    cell = Level::Ladder;
                 }
                 else if (color[0] == 0xff && color[1] == 0x00 && color[2] == 0x00) { //red
-                    level.hazards[x][y] = true;
+                    cell = Level::Hazard;
                 }
                 else if (color[0] == 0xff && color[1] == 0x00 && color[2] == 0xff) { //purple
-                    level.boxes[x][y] = true;
-                    std::cout << "found boxes";
+                    cell = Level::Box;
                 }
             }
         }
         levels.push_back(level);
     }
+    if (levels.empty()) {
+        std::cerr << "ERROR: no levels found in " << level_files << " (expecting 1.png, 2.png, ...)\n";
+        return 1;
+    }
+    std::vector<LevelHeader> level_headers;
+    std::vector<uint8_t> level_records;
+    pack_levels(levels, ChunkCodecDeflate, &level_headers, &level_records); //(each level compressed on its own, so it can be loaded on its own)
 
-    std::ofstream out(data_path("../tilebin"), std::ios::binary);
-    write_chunk("tile", tile_table, &out);
-    write_chunk("pale", palette_table, &out);
-    write_chunk("tmap", tile_to_palette_map, &out);
-    write_chunk("lvls", levels, &out);
+    //write to a temporary file and then rename it over tilebin, so a running game never sees a half-written file:
+    std::string tilebin = data_path("../tilebin");
+    {
+        std::ofstream out(tilebin + ".tmp", std::ios::binary);
+        ChunkWriter writer(&out);
+        writer.write("tile", tile_table);
+        writer.write("tidx", tile_indices); //(not compressed: the game uploads it straight from the mapping)
+        writer.write("pale", palette_table);
+        writer.write("tmap", tile_to_palette_map);
+        writer.write("anim", animations.clips);
+        writer.write("anfr", animations.frames);
+        writer.write("lvlh", level_headers);
+        writer.write("lvlc", level_records); //(not compressed as a whole; the game decodes levels from it in place)
+        writer.finish();
+        if (!out) {
+            std::cerr << "ERROR: failed to write " << tilebin << ".tmp\n";
+            return 1;
+        }
+    }
+#ifdef _WIN32
+    std::remove(tilebin.c_str()); //rename() won't replace an existing file on windows
+#endif
+    if (std::rename((tilebin + ".tmp").c_str(), tilebin.c_str()) != 0) {
+        std::cerr << "ERROR: failed to replace " << tilebin << "\n";
+        return 1;
+    }
 
     std::cout << "done! created " << tile_table.size() << " tiles, " << palette_table.size() << " palettes, and " << levels.size() << " levels.";
 
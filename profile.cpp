@@ -0,0 +1,60 @@
+#include "profile.hpp"
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+	std::mutex &rings_mutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+	//rings are never freed, so a thread that has exited still shows up in dumps:
+	std::vector< std::unique_ptr< ProfileRing > > &rings() { //<-- guarded by rings_mutex()
+		static std::vector< std::unique_ptr< ProfileRing > > list;
+		return list;
+	}
+
+	ProfileRing &new_ring(uint32_t track) {
+		std::lock_guard< std::mutex > lock(rings_mutex());
+		rings().emplace_back(new ProfileRing(track));
+		return *rings().back();
+	}
+}
+
+ProfileRing &profile_new_thread_ring() {
+	return new_ring(trace_thread());
+}
+
+ProfileRing &profile_track_ring(std::string const &name) {
+	return new_ring(trace_track(name));
+}
+
+bool profile_dump(std::string const &filename) {
+	//writers may be lapping the oldest entries while they are copied, so leave a margin:
+	constexpr uint64_t Margin = 1024;
+
+	std::vector< TraceEvent > events;
+	{
+		std::lock_guard< std::mutex > lock(rings_mutex());
+		for (auto const &ring : rings()) {
+			uint64_t head = ring->head.load(std::memory_order_acquire);
+			uint64_t begin = (head > ProfileRing::Size - Margin ? head - (ProfileRing::Size - Margin) : 0);
+			for (uint64_t i = begin; i < head; ++i) {
+				ProfileRing::Sample const &sample = ring->samples[i % ProfileRing::Size];
+				TraceEvent event;
+				event.name = sample.name;
+				event.category = "frame";
+				event.start = trace_time(TraceClock::time_point(TraceClock::duration(sample.start)));
+				event.duration = std::chrono::duration< double, std::micro >(TraceClock::duration(sample.end - sample.start)).count();
+				event.thread = ring->track;
+				events.emplace_back(event);
+			}
+		}
+	}
+
+	if (!write_chrome_trace(filename, events)) return false;
+	std::cout << "Wrote " << events.size() << " profile samples to '" << filename << "'." << std::endl;
+	return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+ * profile -- low-overhead scoped timers for looking inside a frame.
+ *
+ * //e.g.:
+ * void PlayMode::update(float elapsed) {
+ *     PROFILE_SCOPE("PlayMode::update");
+ *     ...
+ * }
+ *
+ * Each thread records finished scopes into its own fixed-size ring buffer (no locks, no allocation),
+ * so only the most recent samples are kept; profile_dump() writes them as a Chrome trace
+ * (open with chrome://tracing or https://ui.perfetto.dev).
+ *
+ * Build with -DPROFILE_ENABLED=0 to compile all scopes away.
+ * See gl_profile.hpp for timing GPU work.
+ *
+ */
+
+#include "chrome_trace.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED 1
+#endif
+
+#define PROFILE_CONCAT2(a, b) a ## b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+
+#if PROFILE_ENABLED
+//time from here to the end of the enclosing scope ('name' must be a string literal):
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) (void)0
+#endif
+
+struct ProfileRing {
+	enum : uint32_t { Size = 1 << 15 }; //samples kept per thread (about 0.75 MB)
+	struct Sample {
+		char const *name;
+		TraceClock::rep start, end;
+	};
+
+	explicit ProfileRing(uint32_t track_) : track(track_) { }
+
+	//add a sample (only from the ring's own thread):
+	void record(char const *name, TraceClock::rep start, TraceClock::rep end) {
+		uint64_t at = head.load(std::memory_order_relaxed);
+		Sample &sample = samples[at % Size];
+		sample.name = name;
+		sample.start = start;
+		sample.end = end;
+		head.store(at + 1, std::memory_order_release);
+	}
+
+	uint32_t track; //chrome trace 'tid'
+	std::atomic< uint64_t > head{0}; //samples recorded so far
+	std::array< Sample, Size > samples;
+};
+
+//the calling thread's ring (created the first time it is asked for):
+ProfileRing &profile_new_thread_ring();
+inline ProfileRing &profile_thread_ring() {
+	static thread_local ProfileRing *ring = nullptr; //(constant-initialized, so no per-call guard)
+	if (!ring) ring = &profile_new_thread_ring();
+	return *ring;
+}
+
+//a ring for a timeline that isn't a CPU thread (e.g., GPU time); only record into it from one thread:
+ProfileRing &profile_track_ring(std::string const &name);
+
+struct ProfileScope {
+	explicit ProfileScope(char const *name_) : name(name_), start(TraceClock::now().time_since_epoch().count()) { }
+	~ProfileScope() {
+		profile_thread_ring().record(name, start, TraceClock::now().time_since_epoch().count());
+	}
+	char const *name;
+	TraceClock::rep start;
+};
+
+//write the samples currently in every ring to a Chrome trace file:
+// (other threads keep recording while this runs; samples that might be overwritten while copying are skipped)
+bool profile_dump(std::string const &filename);
@@ -1,15 +1,21 @@
 #pragma once
 
 #include <iostream>
+#include <string>
 #include <vector>
+#include <cstdint>
 #include <stdexcept>
 #include <cassert>
 
+#include "ChunkCodec.hpp"
+#include "crc32c.hpp"
+
 //helper function that reads an array of structures preceded by a simple header:
 //Expected format:
 // |ma|gi|c.|..| <-- four byte "magic number"
 // |sz|sz|sz|sz| <-- four byte (native endian) size
 // |TT...TT| * (sz/sizeof(TT)) <-- enough T structures to make up sz bytes
+//(chunks may also be compressed, in which case the top bits of 'size' say how -- see ChunkCodec.hpp)
 
 template< typename T >
 void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *to_) {
@@ -26,10 +32,31 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 	if (!from.read(reinterpret_cast< char * >(&header), sizeof(header))) {
 		throw std::runtime_error("Failed to read chunk header");
 	}
+	//skip any padding chunks (see ChunkWriter) in front of the chunk:
+	while (std::string(header.magic,4) == "pad " && magic != "pad ") {
+		if (!from.ignore(header.size) || !from.read(reinterpret_cast< char * >(&header), sizeof(header))) {
+			throw std::runtime_error("Failed to read chunk header");
+		}
+	}
 	if (std::string(header.magic,4) != magic) {
 		throw std::runtime_error("Unexpected magic number in chunk");
 	}
 
+	//compressed chunks (see ChunkCodec.hpp) are decompressed as they are read:
+	ChunkCodec codec = ChunkCodec(header.size >> ChunkCodecShift);
+	if (codec != ChunkCodecRaw) {
+		uint32_t raw_size = 0;
+		if ((header.size & ChunkSizeMask) < sizeof(raw_size) || !from.read(reinterpret_cast< char * >(&raw_size), sizeof(raw_size))) {
+			throw std::runtime_error("Failed to read compressed chunk size.");
+		}
+		if (raw_size % sizeof(T) != 0) {
+			throw std::runtime_error("Size of chunk not divisible by element size");
+		}
+		to.resize(raw_size / sizeof(T));
+		decompress_chunk(codec, from, (header.size & ChunkSizeMask) - sizeof(raw_size), to.data(), raw_size);
+		return;
+	}
+
 	if (header.size % sizeof(T) != 0) {
 		throw std::runtime_error("Size of chunk not divisible by element size");
 	}
@@ -63,3 +90,116 @@ void write_chunk(std::string const &magic, std::vector< T > const &from, std::os
 	to.write(reinterpret_cast< const char * >(&header), sizeof(header));
 	to.write(reinterpret_cast< const char * >(from.data()), from.size() * sizeof(T));
 }
+
+
+//Files written with ChunkWriter end with a table of contents, so readers (see ChunkFile.hpp)
+// can find any chunk by name without reading the chunks before it:
+//
+// |chunk|pad |chunk|...|chunk| <-- chunks, exactly as written by write_chunk, with "pad " chunks between them as needed
+// |to|c |sz|sz|TocEntry * n| <-- "toc " chunk listing every chunk above (except padding)
+// |ta|il|08|00|of|of|of|of|cs|cs|cs|cs| <-- "tail" chunk: offset of the "toc " chunk's header + checksum of its data
+//
+//Checksums are CRC-32C (see crc32c.hpp) of the chunk data as stored (i.e., after compression).
+//
+//Each chunk's data starts at a multiple of ChunkAlignment bytes from the start of the file
+// (so, when mapped, it can be used in place as an array of any basic type -- see ChunkFile::get);
+// the writer gets it there by putting a "pad " chunk of zeros in front of it when needed.
+//
+//Since the padding, table of contents, and tail are ordinary chunks, the file can still be read
+// in order with read_chunk (which skips padding).
+
+constexpr uint32_t ChunkAlignment = 16;
+
+struct ChunkTocEntry {
+	char magic[4] = {'\0', '\0', '\0', '\0'};
+	uint32_t offset = 0; //offset of the chunk's data (not its header) from the start of the file
+	uint32_t size = 0; //size of the chunk's data (+ codec in the top bits, as in the chunk header)
+	uint32_t checksum = 0; //crc32c of the stored data (always recorded; 0 is a valid checksum)
+};
+static_assert(sizeof(ChunkTocEntry) == 16, "toc entry is packed");
+
+struct ChunkWriter {
+	//chunks are written to 'to', which should be at the start of the file:
+	ChunkWriter(std::ostream *to_) : to(*to_) {
+		assert(to_);
+	}
+
+	//write a chunk (optionally compressed) and remember where it went:
+	//(throws, before writing anything, if the chunk won't fit -- see check_fits)
+	template< typename T >
+	void write(std::string const &magic, std::vector< T > const &from, ChunkCodec codec = ChunkCodecRaw) {
+		assert(magic.size() == 4);
+		std::vector< uint8_t > compressed;
+		if (codec != ChunkCodecRaw) {
+			compress_chunk(codec, from.data(), from.size() * sizeof(T), &compressed);
+		}
+		size_t size = (codec == ChunkCodecRaw ? from.size() * sizeof(T) : compressed.size());
+		check_fits(magic, size);
+
+		pad();
+		ChunkTocEntry entry;
+		for (uint32_t i = 0; i < 4; ++i) entry.magic[i] = magic[i];
+		entry.offset = uint32_t(at + 8);
+		entry.size = uint32_t(size);
+
+		if (codec == ChunkCodecRaw) {
+			entry.checksum = crc32c(from.data(), entry.size);
+			write_chunk(magic, from, &to);
+		} else {
+			entry.checksum = crc32c(compressed.data(), entry.size);
+			//same as write_chunk, but with the codec in the size field:
+			uint32_t size_field = entry.size | (uint32_t(codec) << ChunkCodecShift);
+			to.write(magic.data(), 4);
+			to.write(reinterpret_cast< const char * >(&size_field), sizeof(size_field));
+			to.write(reinterpret_cast< const char * >(compressed.data()), compressed.size());
+		}
+		at += 8 + size;
+		entry.size |= uint32_t(codec) << ChunkCodecShift;
+		toc.emplace_back(entry);
+	}
+
+	//write the table of contents (call once, after all chunks):
+	void finish() {
+		check_fits("toc ", toc.size() * sizeof(ChunkTocEntry));
+		pad();
+		uint32_t toc_offset = uint32_t(at);
+		write_chunk("toc ", toc, &to);
+		at += 8 + toc.size() * sizeof(ChunkTocEntry);
+		std::vector< uint32_t > tail{ toc_offset, crc32c(toc.data(), toc.size() * sizeof(ChunkTocEntry)) };
+		write_chunk("tail", tail, &to);
+		at += 8 + tail.size() * sizeof(uint32_t);
+	}
+
+	//throw if 'size' bytes of chunk data can't be written next:
+	// the size has to leave the codec bits in the size field alone,
+	// and the chunk (after any padding) has to end where a 32-bit offset can still reach
+	void check_fits(std::string const &magic, size_t size) const {
+		if (size > ChunkSizeMask) {
+			throw std::runtime_error("Chunk '" + magic + "' is " + std::to_string(size) + " bytes; at most " + std::to_string(ChunkSizeMask) + " can be stored.");
+		}
+		if (at + padding() + 8 + size > 0xffffffff) {
+			throw std::runtime_error("Chunk '" + magic + "' would end " + std::to_string(at + padding() + 8 + size) + " bytes into the file; chunk offsets are 32 bits.");
+		}
+	}
+
+	//bytes of "pad " chunk (header included) needed so the next chunk's data starts at a multiple of ChunkAlignment:
+	size_t padding() const {
+		size_t data_at = at + 8;
+		if (data_at % ChunkAlignment == 0) return 0;
+		//(the padding chunk's own header takes 8 bytes, so it may need to push past one more boundary)
+		return 8 + (ChunkAlignment - (data_at + 8) % ChunkAlignment) % ChunkAlignment;
+	}
+
+	//write a "pad " chunk, if needed:
+	void pad() {
+		size_t bytes = padding();
+		if (bytes == 0) return;
+		write_chunk("pad ", std::vector< uint8_t >(bytes - 8, 0), &to);
+		at += bytes;
+		assert((at + 8) % ChunkAlignment == 0);
+	}
+
+	std::ostream &to;
+	size_t at = 0; //bytes written so far
+	std::vector< ChunkTocEntry > toc;
+};
@@ -0,0 +1,227 @@
+// steps many independent games (see Simulation.hpp) as fast as possible, with no window or GL,
+// spread across all cores -- for fuzzing, search, training, and checking determinism
+//  usage: simulate [--instances N] [--ticks T] [--threads J] [--level L] [--input random|script] [--seed S]
+// (by default, instance i plays level i % (level count); every run with the same arguments ends in the same states,
+//  whatever the thread count, so the combined checksum printed at the end can be compared between builds)
+#include "Simulation.hpp"
+#include "RewindBuffer.hpp"
+#include "LevelPack.hpp"
+#include "ChunkFile.hpp"
+#include "data_path.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+	//small, fast random numbers for driving input (one generator per instance, so results don't depend on scheduling):
+	struct XorShift {
+		uint32_t state;
+		explicit XorShift(uint32_t seed) : state(seed ? seed : 0x466u) { }
+		uint32_t operator()() {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+	};
+
+	void set_button(Simulation::Button *button, bool pressed) {
+		if (pressed && !button->pressed) button->downs += 1;
+		button->pressed = pressed;
+	}
+
+	//random input: now and then, press or release a random direction; very occasionally restart:
+	void random_input(Simulation &sim, XorShift &rng) {
+		uint32_t r = rng();
+		if ((r & 0xf) != 0) return; //(changes on about one tick in 16)
+		r >>= 4;
+		if (r % 1024 == 0) {
+			sim.reset_level();
+			return;
+		}
+		Simulation::Button *buttons[4] = { &sim.left, &sim.right, &sim.down, &sim.up };
+		Simulation::Button *button = buttons[(r >> 10) & 3];
+		set_button(button, !button->pressed);
+	}
+
+	//scripted input: walk a loop (right, up, left, down, rest) every 240 ticks, restarting every fourth loop:
+	void script_input(Simulation &sim) {
+		uint32_t at = sim.tick % 240;
+		set_button(&sim.right, at < 60);
+		set_button(&sim.up, at >= 60 && at < 90);
+		set_button(&sim.left, at >= 90 && at < 150);
+		set_button(&sim.down, at >= 150 && at < 180);
+		if (sim.tick % 960 == 959) sim.reset_level();
+	}
+}
+
+int main(int argc, char **argv) {
+	uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t instances = 0; //(default: four per thread)
+	uint32_t ticks = 1000000;
+	int32_t only_level = -1;
+	bool scripted = false;
+	uint32_t seed = 1;
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--instances" && argi + 1 < argc) {
+			instances = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--ticks" && argi + 1 < argc) {
+			ticks = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--threads" && argi + 1 < argc) {
+			threads = std::max(1u, uint32_t(std::stoul(argv[++argi])));
+		} else if (arg == "--level" && argi + 1 < argc) {
+			only_level = int32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--input" && argi + 1 < argc && (std::string(argv[argi + 1]) == "random" || std::string(argv[argi + 1]) == "script")) {
+			scripted = (std::string(argv[++argi]) == "script");
+		} else if (arg == "--seed" && argi + 1 < argc) {
+			seed = uint32_t(std::stoul(argv[++argi]));
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--instances N] [--ticks T] [--threads J] [--level L] [--input random|script] [--seed S]" << std::endl;
+			return 1;
+		}
+	}
+	if (instances == 0) instances = 4 * threads;
+
+	std::vector< Level > levels;
+	AnimationTable animations;
+	{
+		std::shared_ptr< ChunkFile > file = std::make_shared< ChunkFile >(data_path("../tilebin"));
+		animations.load(*file);
+		LevelPack pack(file);
+		for (uint32_t i = 0; i < pack.size(); ++i) {
+			levels.emplace_back(*pack.get(i));
+		}
+	}
+	if (only_level >= int32_t(levels.size())) {
+		std::cerr << "There is no level " << only_level << " (only " << levels.size() << ")." << std::endl;
+		return 1;
+	}
+
+	std::cout << "Running " << instances << " instances for " << ticks << " ticks each (" << (scripted ? "scripted" : "random") << " input) on "
+		<< threads << " thread" << (threads == 1 ? "" : "s") << "..." << std::endl;
+
+	//instances are handed out one at a time, so threads that finish early pick up the slack:
+	std::atomic< uint32_t > next_instance(0);
+	std::vector< uint32_t > checksums(instances, 0);
+	std::vector< double > thread_seconds(threads, 0.0);
+
+	auto start = std::chrono::steady_clock::now();
+	auto work = [&](uint32_t thread) {
+		auto thread_start = std::chrono::steady_clock::now();
+		uint32_t i;
+		while ((i = next_instance.fetch_add(1)) < instances) {
+			Simulation sim;
+			sim.level = levels[only_level >= 0 ? uint32_t(only_level) : i % levels.size()];
+			sim.animations = animations;
+			sim.reset_level();
+			XorShift rng(seed * 0x9e3779b9u + i);
+			for (uint32_t t = 0; t < ticks; ++t) {
+				if (scripted) script_input(sim);
+				else random_input(sim, rng);
+				sim.step();
+			}
+			checksums[i] = sim.state_checksum();
+		}
+		thread_seconds[thread] = std::chrono::duration< double >(std::chrono::steady_clock::now() - thread_start).count();
+	};
+	std::vector< std::thread > workers;
+	for (uint32_t t = 1; t < threads; ++t) {
+		workers.emplace_back(work, t);
+	}
+	work(0);
+	for (auto &worker : workers) {
+		worker.join();
+	}
+	double seconds = std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count();
+
+	//combined checksum (order matters, so instances can't swap results unnoticed):
+	uint32_t combined = 0;
+	for (uint32_t c : checksums) {
+		combined = combined * 31u + c;
+	}
+
+	double total_ticks = double(instances) * double(ticks);
+	double busiest = *std::max_element(thread_seconds.begin(), thread_seconds.end());
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "  " << total_ticks / 1e6 << "M ticks in " << seconds << " s = " << total_ticks / seconds / 1e6 << "M ticks/s"
+		<< " (" << total_ticks / seconds / threads / 1e6 << "M ticks/s per thread; "
+		<< std::setprecision(0) << total_ticks * Simulation::Tick / seconds << "x real time overall)." << std::endl;
+	std::cout << std::setprecision(2) << "  busiest thread: " << busiest << " s; combined final-state checksum: "
+		<< std::hex << std::setw(8) << std::setfill('0') << combined << std::dec << std::endl;
+
+	//save states are used for restarts, search, and rollback, so they need to be cheap too:
+	{
+		//(worst case: every cell a box)
+		Simulation sim;
+		sim.level.cells.assign(sim.level.cells.size(), Level::Box);
+		sim.reset_level();
+		std::unique_ptr< Simulation::State > state(new Simulation::State());
+		constexpr uint32_t Repeats = 100000;
+		auto before_save = std::chrono::steady_clock::now();
+		for (uint32_t r = 0; r < Repeats; ++r) {
+			sim.tick = r; //(so the copies can't be hoisted out of the loop)
+			sim.save_state(state.get());
+		}
+		auto before_load = std::chrono::steady_clock::now();
+		for (uint32_t r = 0; r < Repeats; ++r) {
+			state->tick = r;
+			sim.load_state(*state);
+		}
+		auto after = std::chrono::steady_clock::now();
+		std::cout << "  save state: " << std::chrono::duration< double, std::micro >(before_load - before_save).count() / Repeats << " us"
+			<< ", load state: " << std::chrono::duration< double, std::micro >(after - before_load).count() / Repeats << " us"
+			<< " (" << sizeof(Simulation::State) << " byte state, " << sim.entities.count << " entities)." << std::endl;
+	}
+
+	//rewind history (as PlayMode keeps it): record a couple of minutes of random play, then step all the way back, checking each state:
+	{
+		Simulation sim;
+		sim.level = levels[only_level >= 0 ? uint32_t(only_level) : 0];
+		sim.animations = animations;
+		sim.reset_level();
+		constexpr size_t RewindBytes = 4 << 20; //(same limits as PlayMode::history)
+		constexpr uint32_t RewindFrames = 60 * 60;
+		RewindBuffer history(sizeof(Simulation::State), RewindBytes, RewindFrames);
+		std::unique_ptr< Simulation::State > state(new Simulation::State());
+		history.set_base(state.get());
+		XorShift rng(seed);
+		constexpr uint32_t Ticks = 2 * RewindFrames;
+		std::vector< uint32_t > expected;
+		expected.reserve(Ticks);
+		double record_seconds = 0.0;
+		for (uint32_t t = 0; t < Ticks; ++t) {
+			random_input(sim, rng);
+			auto before = std::chrono::steady_clock::now();
+			sim.save_state(state.get());
+			history.push(state.get());
+			record_seconds += std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+			expected.emplace_back(sim.state_checksum());
+			sim.step();
+		}
+		uint32_t held = history.frames();
+		size_t used = history.bytes_used();
+		uint32_t mismatches = 0;
+		while (history.pop(state.get())) {
+			sim.load_state(*state);
+			if (sim.state_checksum() != expected[sim.tick]) mismatches += 1;
+		}
+		RewindBuffer::Stats const &stats = history.stats;
+		std::cout << "  rewind: " << std::setprecision(3) << record_seconds * 1e6 / Ticks << " us/tick to record; "
+			<< double(stats.delta_bytes) / std::max< uint64_t >(1, stats.deltas) << " bytes/delta, "
+			<< double(stats.keyframe_bytes) / std::max< uint64_t >(1, stats.keyframes) << " bytes/keyframe; "
+			<< held << " ticks held in " << used / 1024 << " kB; "
+			<< (mismatches ? std::to_string(mismatches) + " states came back WRONG." : std::string("every state came back intact.")) << std::endl;
+		if (mismatches) return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,165 @@
+#include "startup_profile.hpp"
+
+#include "data_path.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <cassert>
+
+namespace {
+	struct Record {
+		TraceEvent event;
+		uint64_t bytes = 0;
+		std::vector< uint32_t > after;
+	};
+
+	std::mutex &records_mutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+	std::vector< Record > &records() { //<-- guarded by records_mutex()
+		static std::vector< Record > list;
+		return list;
+	}
+
+	std::atomic< uint32_t > &pending() {
+		static std::atomic< uint32_t > count{0};
+		return count;
+	}
+
+	//current main-thread phase:
+	std::string phase_name;
+	TraceClock::time_point phase_start;
+	uint64_t phase_bytes = 0;
+}
+
+void startup_phase(std::string const &name) {
+	TraceClock::time_point now = TraceClock::now();
+	if (!phase_name.empty()) {
+		startup_record(phase_name, "phase", phase_start, now, startup_bytes_read() - phase_bytes);
+	}
+	phase_name = name;
+	phase_start = now;
+	phase_bytes = startup_bytes_read();
+}
+
+uint32_t startup_record(
+	std::string const &name,
+	std::string const &category,
+	TraceClock::time_point const &start,
+	TraceClock::time_point const &end,
+	uint64_t bytes,
+	std::vector< uint32_t > const &after
+) {
+	Record record;
+	record.event.name = name;
+	record.event.category = category;
+	record.event.start = trace_time(start);
+	record.event.duration = trace_time(end) - record.event.start;
+	record.event.thread = trace_thread();
+	record.event.args.emplace_back("bytes", double(bytes));
+	record.bytes = bytes;
+	record.after = after;
+
+	std::lock_guard< std::mutex > lock(records_mutex());
+	records().emplace_back(std::move(record));
+	return uint32_t(records().size() - 1);
+}
+
+void startup_pending_begin() {
+	pending() += 1;
+}
+
+void startup_pending_end() {
+	pending() -= 1;
+}
+
+uint32_t startup_pending() {
+	return pending();
+}
+
+void startup_report() {
+	startup_phase(""); //(close any open phase)
+
+	std::vector< Record > list;
+	{
+		std::lock_guard< std::mutex > lock(records_mutex());
+		list = records();
+	}
+
+	//critical path through the dependency edges: longest chain of durations
+	// (records are made when work finishes, so everything in 'after' comes earlier in the list)
+	std::vector< double > chain(list.size(), 0.0);
+	std::vector< int32_t > chain_prev(list.size(), -1);
+	int32_t chain_end = -1;
+	for (uint32_t i = 0; i < list.size(); ++i) {
+		if (list[i].event.category != "load") continue;
+		for (uint32_t a : list[i].after) {
+			assert(a < i);
+			if (chain[a] > chain[i]) {
+				chain[i] = chain[a];
+				chain_prev[i] = int32_t(a);
+			}
+		}
+		chain[i] += list[i].event.duration;
+		if (chain_end < 0 || chain[i] > chain[chain_end]) chain_end = int32_t(i);
+	}
+	std::vector< bool > critical(list.size(), false);
+	for (int32_t i = chain_end; i >= 0; i = chain_prev[i]) {
+		critical[i] = true;
+	}
+
+	double end = 0.0;
+	for (auto const &record : list) {
+		end = std::max(end, record.event.start + record.event.duration);
+	}
+
+	std::ostringstream report;
+	report << std::fixed << std::setprecision(2);
+	auto line = [&](Record const &record, std::string const &note) {
+		report << "  " << std::left << std::setw(32) << record.event.name << std::right
+			<< std::setw(10) << record.event.duration / 1000.0 << " ms"
+			<< std::setw(10) << record.event.start / 1000.0 << " ms start"
+			<< std::setw(12) << record.bytes << " bytes"
+			<< "  thread " << record.event.thread
+			<< note << "\n";
+	};
+
+	report << "Startup took " << end / 1000.0 << " ms.\n";
+	for (std::string category : { "phase", "load", "tilebin" }) {
+		double total = 0.0;
+		uint32_t count = 0;
+		for (auto const &record : list) {
+			if (record.event.category != category) continue;
+			total += record.event.duration;
+			count += 1;
+		}
+		if (count == 0) continue;
+		report << category << " (" << count << ", " << total / 1000.0 << " ms total";
+		if (category == "load") report << ", " << (chain_end >= 0 ? chain[chain_end] : 0.0) / 1000.0 << " ms critical path";
+		report << "):\n";
+		for (uint32_t i = 0; i < list.size(); ++i) {
+			if (list[i].event.category != category) continue;
+			line(list[i], critical[i] ? "  [critical path]" : "");
+		}
+	}
+
+	std::cout << report.str() << std::flush;
+	{
+		std::ofstream out(data_path("startup-profile.txt"));
+		out << report.str();
+	}
+
+	std::vector< TraceEvent > events;
+	events.reserve(list.size());
+	for (uint32_t i = 0; i < list.size(); ++i) {
+		events.emplace_back(list[i].event);
+		if (critical[i]) events.back().args.emplace_back("critical_path", 1.0);
+	}
+	write_chrome_trace(data_path("startup-trace.json"), events);
+}
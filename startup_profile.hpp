@@ -0,0 +1,48 @@
+#pragma once
+
+/*
+ * startup_profile -- where does launch time go?
+ *
+ * main() marks its startup phases with startup_phase(), each Load<> function is timed by call_load_functions(),
+ * and background loading (e.g., TileBinLoader) records its own steps.
+ * Once startup is over, startup_report() prints a summary (per-phase and per-loader wall time, bytes read,
+ * and which loaders are on the critical path) and writes it to 'startup-profile.txt',
+ * along with a Chrome trace of the same events in 'startup-trace.json' (both next to the executable).
+ *
+ */
+
+#include "chrome_trace.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//start a new phase of startup on the main thread, ending the previous one:
+// (pass "" to just end the previous phase)
+void startup_phase(std::string const &name);
+
+//record a finished piece of startup work (from any thread); returns an id for use in 'after':
+// 'after' lists the ids of work that had to finish before this could start (used to find the critical path)
+uint32_t startup_record(
+	std::string const &name,
+	std::string const &category,
+	TraceClock::time_point const &start,
+	TraceClock::time_point const &end,
+	uint64_t bytes,
+	std::vector< uint32_t > const &after = std::vector< uint32_t >()
+);
+
+//bytes read from files by the calling thread so far (file readers add to this):
+inline uint64_t &startup_bytes_read() {
+	static thread_local uint64_t bytes = 0;
+	return bytes;
+}
+
+//startup isn't over until background work that calls startup_pending_begin() calls startup_pending_end():
+void startup_pending_begin();
+void startup_pending_end();
+uint32_t startup_pending();
+
+//print and write the report:
+// (call once, after the first frame, once startup_pending() is zero)
+void startup_report();